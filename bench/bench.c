@@ -0,0 +1,117 @@
+/*
+ * Copyright 2017 Francesco Circhetta
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+#define _POSIX_C_SOURCE 200809L
+
+#include <time.h>
+#include <sys/resource.h>
+
+#include "utils.h"
+#include "bench.h"
+
+/****************************************************************************
+ * Private Data
+ ****************************************************************************/
+static const void *volatile sink;
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+/**
+ * Monotonic time in seconds
+ */
+double bench_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec + (double) ts.tv_nsec * 1e-9;
+}
+
+/**
+ * Peak resident set size of the process, in KB
+ */
+long bench_maxrss_kb(void) {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+/**
+ * Keep the compiler from optimizing away a computed value
+ */
+void bench_sink(const void *ptr) {
+    sink = ptr;
+}
+
+/**
+ * File name without its directory and extension, for reports
+ */
+const char *bench_basename(const char *path) {
+    static char name[64];
+    const char *start = strrchr(path, '/');
+    start = start ? start + 1 : path;
+    strncpy(name, start, sizeof(name) - 1);
+    char *dot = strrchr(name, '.');
+    if (dot) *dot = '\0';
+    return name;
+}
+
+/**
+ * Load a whole text file in memory, split in lines. Exit on failure.
+ */
+bench_lines_t bench_read_lines(const char *path) {
+    bench_lines_t lines = {NULL, NULL, 0, NULL};
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) {
+        fprintf(stderr, "cannot open %s\n", path);
+        exit(1);
+    }
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    lines.data = malloc_or_die((size_t) size + 1);
+    size_t read = fread(lines.data, 1, (size_t) size, f);
+    fclose(f);
+    lines.data[read] = '\0';
+    size_t capacity = 0;
+    char *cur = lines.data;
+    while (*cur) {
+        char *end = strchr(cur, '\n');
+        if (end) *end = '\0';
+        if (lines.count == capacity) {
+            capacity = capacity ? capacity * 2 : 1024;
+            lines.line = realloc_or_die(lines.line, capacity * sizeof(char *));
+            lines.len = realloc_or_die(lines.len, capacity * sizeof(size_t));
+        }
+        lines.line[lines.count] = cur;
+        lines.len[lines.count] = end ? (size_t) (end - cur) : strlen(cur);
+        lines.count++;
+        if (end == NULL) break;
+        cur = end + 1;
+    }
+    return lines;
+}
+
+/**
+ * Release the memory of bench_read_lines()
+ */
+void bench_free_lines(bench_lines_t *lines) {
+    free(lines->line);
+    free(lines->len);
+    free(lines->data);
+}
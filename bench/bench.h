@@ -0,0 +1,51 @@
+/*
+ * Copyright 2017 Francesco Circhetta
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef API_BENCH_H
+#define API_BENCH_H
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/****************************************************************************
+ * Public Types
+ ****************************************************************************/
+/* Lines of a text file, NUL-terminated and without the newline */
+typedef struct _bench_lines {
+    char                **line;
+    size_t              *len;
+    size_t              count;
+    char                *data;
+} bench_lines_t;
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+double bench_now(void);
+long bench_maxrss_kb(void);
+void bench_sink(const void *);
+const char *bench_basename(const char *);
+bench_lines_t bench_read_lines(const char *);
+void bench_free_lines(bench_lines_t *);
+
+#endif //API_BENCH_H
@@ -0,0 +1,82 @@
+/*
+ * Copyright 2017 Francesco Circhetta
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * One huge directory: create, look up, find and recursively delete n
+ * files, against a simplefs built without the per-directory limit. The
+ * resident memory growth gives the cost of an entry, node and name
+ * included.
+ *
+ * usage: bench-bigdir [files]
+ */
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+#include "bench.h"
+#include "simplefs.h"
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+int main(int argc, char **argv) {
+    size_t count = argc > 1 ? (size_t) atol(argv[1]) : 1000000;
+    char **names = malloc_or_die(count * sizeof(char *));
+    for (size_t i = 0; i < count; i++) {
+        names[i] = malloc_or_die(16);
+        sprintf(names[i], "file%zu", i);
+    }
+    node_t *root = fs_new_root();
+    fs_create(root, "big", Dir);
+    node_t *dir = fs_find_in_dir(root, "big");
+    long rss = bench_maxrss_kb();
+
+    double start = bench_now();
+    for (size_t i = 0; i < count; i++) {
+        if (!fs_create(dir, names[i], File)) {
+            fprintf(stderr, "create %s failed\n", names[i]);
+            return 1;
+        }
+    }
+    double create = bench_now() - start;
+    long grown = bench_maxrss_kb() - rss;
+
+    start = bench_now();
+    for (size_t i = 0; i < count; i++)
+        bench_sink(fs_find_in_dir(dir, names[(i * 7919) % count]));
+    double lookup = bench_now() - start;
+
+    size_t nres = 0;
+    start = bench_now();
+    node_t **res = fs_find_r(root, names[count / 2], &nres, NULL);
+    double find = bench_now() - start;
+    free(res);
+
+    start = bench_now();
+    fs_delete(dir, true);
+    double delete = bench_now() - start;
+
+    printf("%zu files in one directory (ns per file, bytes per file)\n", count);
+    printf("%10s %10s %10s %10s %10s\n", "create", "lookup", "find", "delete_r", "memory");
+    printf("%10.1f %10.1f %10.1f %10.1f %10.1f\n", create * 1e9 / count,
+           lookup * 1e9 / count, find * 1e9 / count, delete * 1e9 / count,
+           grown * 1024.0 / count);
+    fs_destroy_root(root);
+    for (size_t i = 0; i < count; i++)
+        free(names[i]);
+    free(names);
+    return 0;
+}
@@ -0,0 +1,100 @@
+/*
+ * Copyright 2017 Francesco Circhetta
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * Hash flooding: names crafted to share the low hash bits under a known
+ * seed, as a journal author could do against a compile-time seed, are
+ * inserted and looked up once under that seed and once under a fresh
+ * random one. The default stays below the probe distance the Robin Hood
+ * engine can record, past which it gives up.
+ *
+ * usage: bench-flood-<variant> [names] [bits]
+ */
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+#include "bench.h"
+#include "utils.h"
+#include "hash.h"
+#include "hashtable.h"
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+/* The seed every build used before it was randomized */
+#define BENCH_KNOWN_SEED 1023724138
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+/**
+ * Time inserting then finding every name, in ns per operation.
+ */
+static double flood(char **names, size_t count) {
+    hashtable_t *t = hashtable_create();
+    double start = bench_now();
+    for (size_t i = 0; i < count; i++)
+        hashtable_set(t, names[i], names[i]);
+    for (size_t i = 0; i < count; i++)
+        bench_sink(hashtable_get(t, names[i]));
+    double elapsed = bench_now() - start;
+    hashtable_destroy(t);
+    return elapsed * 1e9 / (2 * count);
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+int main(int argc, char **argv) {
+    size_t count = argc > 1 ? (size_t) atol(argv[1]) : 250;
+    unsigned int bits = argc > 2 ? (unsigned int) atoi(argv[2]) : 16;
+    uint64_t mask = ((uint64_t) 1 << bits) - 1;
+    uint64_t random_seed = hash_get_seed();
+    char **crafted = malloc_or_die(count * sizeof(char *));
+    char **plain = malloc_or_die(count * sizeof(char *));
+    char name[32];
+
+    /* Search the names an attacker would send */
+    hash_set_seed(BENCH_KNOWN_SEED);
+    size_t n = 0;
+    for (unsigned long i = 0; n < count; i++) {
+        int len = sprintf(name, "f%lu", i);
+        if ((hash_string(name, (size_t) len) & mask) == 0)
+            crafted[n++] = my_strdup(name);
+    }
+    for (size_t i = 0; i < count; i++) {
+        sprintf(name, "f%zu", i);
+        plain[i] = my_strdup(name);
+    }
+
+    /* Warm up the allocator, so that the first row is not penalized */
+    flood(plain, count);
+    printf("%zu names sharing their low %u hash bits under seed %d\n",
+           count, bits, BENCH_KNOWN_SEED);
+    printf("%-12s %14s %14s\n", "seed", "crafted ns/op", "plain ns/op");
+    printf("%-12s %14.1f %14.1f\n", "known", flood(crafted, count), flood(plain, count));
+    hash_set_seed(random_seed);
+    printf("%-12s %14.1f %14.1f\n", "random", flood(crafted, count), flood(plain, count));
+
+    for (size_t i = 0; i < count; i++) {
+        free(crafted[i]);
+        free(plain[i]);
+    }
+    free(crafted);
+    free(plain);
+    return 0;
+}
@@ -0,0 +1,112 @@
+/*
+ * Copyright 2017 Francesco Circhetta
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * Latency distribution of single hashtable_get() calls, hits and misses,
+ * on a table filled right up to its growth threshold. Each key keeps its
+ * fastest time over all passes, which filters out interrupts and leaves
+ * the cost of its own probe sequence.
+ *
+ * usage: bench-get-<variant> [keys] [passes]
+ */
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+#include "bench.h"
+#include "utils.h"
+#include "hashtable.h"
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+static int compare_double(const void *a, const void *b) {
+    double x = *(const double *) a, y = *(const double *) b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * Fastest lookup time of every key over the given number of passes.
+ */
+static void time_gets(hashtable_t *t, char **keys, size_t count, int passes, double *lat) {
+    for (size_t i = 0; i < count; i++)
+        lat[i] = 1;
+    for (int p = 0; p < passes; p++) {
+        for (size_t i = 0; i < count; i++) {
+            double start = bench_now();
+            bench_sink(hashtable_get(t, keys[i]));
+            double elapsed = bench_now() - start;
+            if (elapsed < lat[i])
+                lat[i] = elapsed;
+        }
+    }
+    qsort(lat, count, sizeof(double), compare_double);
+}
+
+static void print_row(const char *name, const double *lat, size_t count) {
+    printf("%-6s %8.0f %8.0f %8.0f %8.0f\n", name, lat[count / 2] * 1e9,
+           lat[count * 99 / 100] * 1e9, lat[count * 999 / 1000] * 1e9, lat[count - 1] * 1e9);
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+int main(int argc, char **argv) {
+    size_t limit = argc > 1 ? (size_t) atol(argv[1]) : 100000;
+    int passes = argc > 2 ? atoi(argv[2]) : 5;
+    hashtable_t *t = hashtable_create();
+    char **keys = malloc_or_die(limit * sizeof(char *));
+    char **misses = malloc_or_die(limit * sizeof(char *));
+    size_t count = 0;
+    for (; count < limit; count++) {
+        keys[count] = malloc_or_die(16);
+        misses[count] = malloc_or_die(16);
+        sprintf(keys[count], "file%zu", count);
+        sprintf(misses[count], "miss%zu", count);
+    }
+    /* Find the insertion growing the table past half the keys, then fill a
+     * new table up to right before it */
+    uint32_t capacity = t->capacity;
+    for (size_t i = 0; i < limit; i++) {
+        hashtable_set(t, keys[i], &keys[i]);
+        if (i > limit / 2 && t->capacity != capacity) {
+            count = i;
+            break;
+        }
+        capacity = t->capacity;
+    }
+    hashtable_destroy(t);
+    t = hashtable_create();
+    for (size_t i = 0; i < count; i++)
+        hashtable_set(t, keys[i], &keys[i]);
+    double *lat = malloc_or_die(count * sizeof(double));
+    printf("%zu keys, load %.2f (ns per get, fastest of %d passes)\n",
+           count, (double) hashtable_get_size(t) / t->capacity, passes);
+    printf("%-6s %8s %8s %8s %8s\n", "", "p50", "p99", "p99.9", "max");
+    time_gets(t, keys, count, passes, lat);
+    print_row("hit", lat, count);
+    time_gets(t, misses, count, passes, lat);
+    print_row("miss", lat, count);
+    hashtable_destroy(t);
+    for (size_t i = 0; i < limit; i++) {
+        free(keys[i]);
+        free(misses[i]);
+    }
+    free(keys);
+    free(misses);
+    free(lat);
+    return 0;
+}
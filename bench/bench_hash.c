@@ -0,0 +1,152 @@
+/*
+ * Copyright 2017 Francesco Circhetta
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * Hash functions timed over the names found in journals, the keys our
+ * tables actually see, plus the mean linear probe length they give on a
+ * half full table of the distinct names.
+ *
+ * usage: bench-hash [-r repetitions] journal...
+ */
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+#include "bench.h"
+#include "utils.h"
+#include "hash.h"
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+#define TOK_SPACE " \n\r\t"
+#define TOK_PATH " /\n\r\t"
+
+/****************************************************************************
+ * Private Types
+ ****************************************************************************/
+typedef struct _bench_hash {
+    const char          *name;
+    uint64_t            (*fn)(const char *, size_t, uint64_t);
+} bench_hash_t;
+
+/****************************************************************************
+ * Private Data
+ ****************************************************************************/
+static const bench_hash_t functions[] = {
+    {"murmur", hash_murmur},
+    {"wyhash", hash_wyhash},
+    {"xxh3", hash_xxh3},
+    {"crc32c", hash_crc32c},
+};
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+/**
+ * Mean probe length of the names in a linear probing table of twice as many
+ * slots, using the low bits of the hash like the engines do.
+ */
+static double probe_length(const bench_hash_t *h, char **names, size_t *lens, size_t count) {
+    size_t capacity = 1;
+    while (capacity < 2 * count) capacity *= 2;
+    bool *used = calloc_or_die(capacity, sizeof(bool));
+    size_t probes = 0;
+    for (size_t i = 0; i < count; i++) {
+        size_t idx = (uint32_t) h->fn(names[i], lens[i], 0) & (capacity - 1);
+        for (probes++; used[idx]; probes++)
+            idx = (idx + 1) & (capacity - 1);
+        used[idx] = true;
+    }
+    free(used);
+    return (double) probes / count;
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+int main(int argc, char **argv) {
+    int reps = 50;
+    int first = 1;
+    if (argc > 2 && strcmp(argv[1], "-r") == 0) {
+        reps = atoi(argv[2]);
+        first = 3;
+    }
+    /* Every path component of every command, in journal order */
+    size_t count = 0, size = 1024;
+    char **names = malloc_or_die(size * sizeof(char *));
+    bench_lines_t *journals = malloc_or_die((size_t) argc * sizeof(bench_lines_t));
+    for (int j = first; j < argc; j++) {
+        journals[j] = bench_read_lines(argv[j]);
+        for (size_t i = 0; i < journals[j].count; i++) {
+            if (strtok(journals[j].line[i], TOK_SPACE) == NULL) continue;
+            for (char *name = strtok(NULL, TOK_PATH); name; name = strtok(NULL, TOK_PATH)) {
+                if (count == size) {
+                    size *= 2;
+                    names = realloc_or_die(names, size * sizeof(char *));
+                }
+                names[count++] = name;
+            }
+        }
+    }
+    if (count == 0) {
+        fprintf(stderr, "usage: bench-hash [-r repetitions] journal...\n");
+        return 1;
+    }
+    size_t *lens = malloc_or_die(count * sizeof(size_t));
+    size_t total_len = 0;
+    for (size_t i = 0; i < count; i++) {
+        lens[i] = strlen(names[i]);
+        total_len += lens[i];
+    }
+    /* Distinct names, for the probe lengths */
+    char **sorted = malloc_or_die(count * sizeof(char *));
+    memcpy(sorted, names, count * sizeof(char *));
+    qsort(sorted, count, sizeof(char *), compare_str);
+    size_t distinct = 0;
+    for (size_t i = 0; i < count; i++)
+        if (distinct == 0 || strcmp(sorted[distinct - 1], sorted[i]) != 0)
+            sorted[distinct++] = sorted[i];
+    size_t *sorted_lens = malloc_or_die(distinct * sizeof(size_t));
+    for (size_t i = 0; i < distinct; i++)
+        sorted_lens[i] = strlen(sorted[i]);
+
+    printf("%zu names (%zu distinct), %.1f bytes on average\n", count, distinct,
+           (double) total_len / count);
+    printf("%-10s %10s %12s\n", "function", "ns/name", "probe len");
+    for (size_t f = 0; f < sizeof(functions) / sizeof(functions[0]); f++) {
+        double best = 0;
+        for (int r = 0; r < reps; r++) {
+            uint64_t acc = 0;
+            double start = bench_now();
+            for (size_t i = 0; i < count; i++)
+                acc += functions[f].fn(names[i], lens[i], acc & 1);
+            double elapsed = bench_now() - start;
+            bench_sink(&acc);
+            if (r == 0 || elapsed < best) best = elapsed;
+        }
+        printf("%-10s %10.2f %12.3f\n", functions[f].name, best * 1e9 / count,
+               probe_length(&functions[f], sorted, sorted_lens, distinct));
+    }
+    for (int j = first; j < argc; j++)
+        bench_free_lines(&journals[j]);
+    free(journals);
+    free(names);
+    free(lens);
+    free(sorted);
+    free(sorted_lens);
+    return 0;
+}
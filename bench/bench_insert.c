@@ -0,0 +1,80 @@
+/*
+ * Copyright 2017 Francesco Circhetta
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * Latency distribution of single hashtable_set() calls while a table grows
+ * from empty, to spot the spikes of synchronous rehashing.
+ *
+ * usage: bench-insert-<variant> [keys] [tables]
+ */
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+#include "bench.h"
+#include "utils.h"
+#include "hashtable.h"
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+static int compare_double(const void *a, const void *b) {
+    double x = *(const double *) a, y = *(const double *) b;
+    return (x > y) - (x < y);
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+int main(int argc, char **argv) {
+    size_t nkeys = argc > 1 ? (size_t) atol(argv[1]) : 26000;
+    size_t ntables = argc > 2 ? (size_t) atol(argv[2]) : 20;
+    char **keys = malloc_or_die(nkeys * sizeof(char *));
+    double *lat = malloc_or_die(nkeys * ntables * sizeof(double));
+    double *worst = calloc_or_die(ntables, sizeof(double));
+    for (size_t i = 0; i < nkeys; i++) {
+        keys[i] = malloc_or_die(16);
+        sprintf(keys[i], "file%zu", i);
+    }
+    double total = 0;
+    for (size_t n = 0; n < ntables; n++) {
+        hashtable_t *t = hashtable_create();
+        for (size_t i = 0; i < nkeys; i++) {
+            double start = bench_now();
+            hashtable_set(t, keys[i], keys[i]);
+            lat[n * nkeys + i] = bench_now() - start;
+            total += lat[n * nkeys + i];
+            if (lat[n * nkeys + i] > worst[n])
+                worst[n] = lat[n * nkeys + i];
+        }
+        hashtable_destroy(t);
+    }
+    size_t count = nkeys * ntables;
+    qsort(lat, count, sizeof(double), compare_double);
+    /* The worst insert of the median table is robust to scheduler noise */
+    qsort(worst, ntables, sizeof(double), compare_double);
+    printf("%8s %8s %8s %8s %10s %10s (ns per insert, %zu keys x %zu tables)\n",
+           "mean", "p50", "p99", "p99.9", "worst", "max", nkeys, ntables);
+    printf("%8.0f %8.0f %8.0f %8.0f %10.0f %10.0f\n", total / count * 1e9,
+           lat[count / 2] * 1e9, lat[count * 99 / 100] * 1e9,
+           lat[count * 999 / 1000] * 1e9, worst[ntables / 2] * 1e9, lat[count - 1] * 1e9);
+    for (size_t i = 0; i < nkeys; i++)
+        free(keys[i]);
+    free(keys);
+    free(lat);
+    free(worst);
+    return 0;
+}
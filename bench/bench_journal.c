@@ -0,0 +1,266 @@
+/*
+ * Copyright 2017 Francesco Circhetta
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * Replay journals in memory through the simplefs API and time them, so that
+ * process startup and stdio do not hide the cost of the data structures.
+ *
+ * usage: bench-journal [-r repetitions] [-b budget-KB] journal...
+ *
+ * With FS_DEDUP_CONTENTS, an untimed replay first reports on stderr what
+ * the content store holds when the files hold the most, and at the end.
+ * With FS_COMPRESS_CONTENTS, it reports the compressed contents at their
+ * largest, and how often and how fast reads decoded them. With
+ * FS_SPILL_CONTENTS, contents are held to the budget given with -b, and it
+ * reports how much went to the spill file and how many reads came back
+ * from it.
+ */
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+#include "bench.h"
+#include "simplefs.h"
+#ifdef FS_DEDUP_CONTENTS
+#include "content.h"
+#endif
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+#define TOK_SPACE " \n\r\t"
+#define TOK_PATH " /\n\r\t"
+#define TOK_CONTENT "\"\n\r\t"
+
+/* Every journal is replayed inside this directory, dropped after each run */
+#define BENCH_DIR "bench"
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+/**
+ * Walk the path in the current strtok() line, same as main.c does.
+ */
+static node_t *walk(node_t *node, char *path, char **new_name) {
+    char *cur = strtok(path, TOK_PATH);
+    if (cur == NULL) return NULL;
+    char *next = strtok(NULL, TOK_PATH);
+    while (cur) {
+        node_t *tmp;
+        if (fs_get_type(node) != Dir) return NULL;
+        if ((tmp = fs_find_name(node, fs_lookup_name(cur)))) {
+            node = tmp;
+            cur = next;
+            next = strtok(NULL, TOK_PATH);
+        } else {
+            if (new_name == NULL || next != NULL) return NULL;
+            *new_name = cur;
+            cur = NULL;
+        }
+    }
+    return node;
+}
+
+/**
+ * Execute one journal line; return false on "exit".
+ */
+static bool replay_line(node_t *dir, char *line) {
+    char *cmd = strtok(line, TOK_SPACE);
+    char *name = NULL;
+    node_t *node;
+    if (cmd == NULL) return true;
+    if (strcmp(cmd, "create") == 0 || strcmp(cmd, "create_dir") == 0) {
+        node = walk(dir, NULL, &name);
+        if (node != NULL && name != NULL)
+            fs_create(node, name, cmd[6] == '_' ? Dir : File);
+    } else if (strcmp(cmd, "read") == 0) {
+        node = walk(dir, NULL, NULL);
+        if (node != NULL)
+            bench_sink(fs_get_file_content(node));
+    } else if (strcmp(cmd, "write") == 0) {
+        char *path = strtok(NULL, TOK_SPACE);
+        char *content = strtok(NULL, TOK_CONTENT);
+        node = walk(dir, path, NULL);
+        if (node != NULL && content != NULL)
+            fs_set_file_content(node, content);
+    } else if (strcmp(cmd, "delete") == 0 || strcmp(cmd, "delete_r") == 0) {
+        node = walk(dir, NULL, NULL);
+        if (node != NULL)
+            fs_delete(node, cmd[6] == '_');
+    } else if (strcmp(cmd, "find") == 0) {
+        size_t nres = 0;
+        node_t **res = fs_find_r(dir, strtok(NULL, TOK_SPACE), &nres, NULL);
+        if (nres > 0) {
+            char **paths = malloc_or_die(nres * sizeof(char *));
+            for (size_t i = 0; i < nres; i++)
+                paths[i] = fs_get_path(res[i], 0);
+            qsort(paths, nres, sizeof(char *), compare_str);
+            for (size_t i = 0; i < nres; i++)
+                free(paths[i]);
+            free(paths);
+            free(res);
+        }
+    } else if (strcmp(cmd, "exit") == 0) {
+        return false;
+    }
+    return true;
+}
+
+#ifdef FS_DEDUP_CONTENTS
+/**
+ * Print what the content store holds against separate copies
+ */
+static void print_contents(const char *journal, const char *when, content_stats_t stats) {
+    fprintf(stderr, "%-16s %-5s %6zu contents for %6zu files, %9zu bytes for %9zu (%.2fx)\n",
+            journal, when, stats.contents, stats.references, stats.bytes, stats.copied_bytes,
+            stats.bytes ? (double) stats.copied_bytes / stats.bytes : 1.0);
+}
+
+/**
+ * Replay a journal in dir, and report on the content store
+ */
+static void report_contents(node_t *dir, bench_lines_t *journal, char *scratch,
+                            const char *name) {
+    content_stats_t peak = content_get_stats();
+    for (size_t i = 0; i < journal->count; i++) {
+        memcpy(scratch, journal->line[i], journal->len[i] + 1);
+        if (!replay_line(dir, scratch)) break;
+        content_stats_t stats = content_get_stats();
+        if (stats.copied_bytes > peak.copied_bytes)
+            peak = stats;
+    }
+    print_contents(name, "peak", peak);
+    print_contents(name, "end", content_get_stats());
+}
+#endif
+
+#ifdef FS_COMPRESS_CONTENTS
+/**
+ * Replay a journal in dir, and report on compressed contents
+ */
+static void report_compression(node_t *dir, bench_lines_t *journal, char *scratch,
+                               const char *name) {
+    fs_compress_stats_t start = fs_get_compress_stats();
+    fs_compress_stats_t peak = start;
+    for (size_t i = 0; i < journal->count; i++) {
+        memcpy(scratch, journal->line[i], journal->len[i] + 1);
+        if (!replay_line(dir, scratch)) break;
+        fs_compress_stats_t stats = fs_get_compress_stats();
+        if (stats.bytes > peak.bytes)
+            peak = stats;
+    }
+    fs_compress_stats_t end = fs_get_compress_stats();
+    size_t decodes = end.decodes - start.decodes;
+    fprintf(stderr, "%-16s peak  %6zu files, %9zu bytes in %9zu (%.2fx), %zu rejected\n",
+            name, peak.files, peak.bytes, peak.compressed_bytes,
+            peak.compressed_bytes ? (double) peak.bytes / peak.compressed_bytes : 1.0,
+            end.rejected - start.rejected);
+    fprintf(stderr, "%-16s reads %6zu, %zu decoded in %.1f us each\n", name,
+            end.reads - start.reads, decodes,
+            decodes ? (end.decode_seconds - start.decode_seconds) * 1e6 / decodes : 0.0);
+}
+#endif
+
+#ifdef FS_SPILL_CONTENTS
+/**
+ * Replay a journal in dir, and report on the spill file
+ */
+static void report_spill(node_t *dir, bench_lines_t *journal, char *scratch,
+                         const char *name) {
+    fs_spill_stats_t start = fs_get_spill_stats();
+    fs_spill_stats_t peak = start;
+    for (size_t i = 0; i < journal->count; i++) {
+        memcpy(scratch, journal->line[i], journal->len[i] + 1);
+        if (!replay_line(dir, scratch)) break;
+        fs_spill_stats_t stats = fs_get_spill_stats();
+        if (stats.resident_bytes + stats.spilled_bytes > peak.resident_bytes + peak.spilled_bytes)
+            peak = stats;
+    }
+    fs_spill_stats_t end = fs_get_spill_stats();
+    size_t hits = end.hits - start.hits;
+    size_t misses = end.misses - start.misses;
+    fprintf(stderr, "%-16s peak  %6zu files, %9zu bytes resident, %6zu files, %9zu bytes "
+            "spilled\n", name, peak.resident_files, peak.resident_bytes, peak.spilled_files,
+            peak.spilled_bytes);
+    fprintf(stderr, "%-16s reads %6zu hits, %6zu misses (%.1f%%), %9zu bytes evicted, "
+            "%9zu in the file\n", name, hits, misses,
+            hits + misses ? 100.0 * misses / (hits + misses) : 0.0,
+            end.evicted_bytes - start.evicted_bytes, (size_t) peak.file_bytes);
+}
+#endif
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+int main(int argc, char **argv) {
+    int reps = 50;
+    int first = 1;
+    while (first + 1 < argc && argv[first][0] == '-') {
+        if (strcmp(argv[first], "-r") == 0)
+            reps = atoi(argv[first + 1]);
+#ifdef FS_SPILL_CONTENTS
+        else if (strcmp(argv[first], "-b") == 0)
+            fs_set_spill_budget((size_t) atol(argv[first + 1]) * 1024);
+#endif
+        first += 2;
+    }
+    node_t *root = fs_new_root();
+    printf("%-16s %8s %12s %12s\n", "journal", "lines", "ns/line", "maxrss(KB)");
+    for (int j = first; j < argc; j++) {
+        bench_lines_t journal = bench_read_lines(argv[j]);
+        size_t longest = 0;
+        for (size_t i = 0; i < journal.count; i++)
+            if (journal.len[i] > longest) longest = journal.len[i];
+        char *scratch = malloc_or_die(longest + 1);
+        double best = 0;
+#ifdef FS_DEDUP_CONTENTS
+        fs_create(root, BENCH_DIR, Dir);
+        report_contents(fs_find_in_dir(root, BENCH_DIR), &journal, scratch,
+                        bench_basename(argv[j]));
+        fs_delete(fs_find_in_dir(root, BENCH_DIR), true);
+#endif
+#ifdef FS_COMPRESS_CONTENTS
+        fs_create(root, BENCH_DIR, Dir);
+        report_compression(fs_find_in_dir(root, BENCH_DIR), &journal, scratch,
+                           bench_basename(argv[j]));
+        fs_delete(fs_find_in_dir(root, BENCH_DIR), true);
+#endif
+#ifdef FS_SPILL_CONTENTS
+        fs_create(root, BENCH_DIR, Dir);
+        report_spill(fs_find_in_dir(root, BENCH_DIR), &journal, scratch,
+                     bench_basename(argv[j]));
+        fs_delete(fs_find_in_dir(root, BENCH_DIR), true);
+#endif
+        for (int r = 0; r < reps; r++) {
+            fs_create(root, BENCH_DIR, Dir);
+            node_t *dir = fs_find_in_dir(root, BENCH_DIR);
+            double start = bench_now();
+            for (size_t i = 0; i < journal.count; i++) {
+                memcpy(scratch, journal.line[i], journal.len[i] + 1);
+                if (!replay_line(dir, scratch)) break;
+            }
+            double elapsed = bench_now() - start;
+            if (r == 0 || elapsed < best) best = elapsed;
+            fs_delete(dir, true);
+        }
+        printf("%-16s %8zu %12.1f %12ld\n", bench_basename(argv[j]), journal.count,
+               best * 1e9 / journal.count, bench_maxrss_kb());
+        free(scratch);
+        bench_free_lines(&journal);
+    }
+    fs_destroy_root(root);
+    return 0;
+}
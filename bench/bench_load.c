@@ -0,0 +1,81 @@
+/*
+ * Copyright 2017 Francesco Circhetta
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * Lookup cost of a table filled up to a given load factor, for hits and
+ * misses. Build against engines with HT_MAX_LOAD above the highest load
+ * factor measured, otherwise the table grows before reaching it.
+ *
+ * usage: bench-load-<engine> [capacity] [rounds]
+ */
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+#include "bench.h"
+#include "utils.h"
+#include "hashtable.h"
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+int main(int argc, char **argv) {
+    size_t capacity = argc > 1 ? (size_t) atol(argv[1]) : 16384;
+    int rounds = argc > 2 ? atoi(argv[2]) : 20;
+    const double loads[] = {0.5, 0.6, 0.7, 0.8, 0.9};
+    char **keys = malloc_or_die(capacity * sizeof(char *));
+    char **misses = malloc_or_die(capacity * sizeof(char *));
+    for (size_t i = 0; i < capacity; i++) {
+        keys[i] = malloc_or_die(16);
+        misses[i] = malloc_or_die(16);
+        sprintf(keys[i], "file%zu", i);
+        sprintf(misses[i], "miss%zu", i);
+    }
+    printf("%6s %10s %10s %10s (ns per op, capacity %zu)\n",
+           "load", "insert", "get hit", "get miss", capacity);
+    for (size_t l = 0; l < sizeof(loads) / sizeof(loads[0]); l++) {
+        size_t n = (size_t) (loads[l] * capacity);
+        double insert = 0, hit = 0, miss = 0;
+        for (int r = 0; r < rounds; r++) {
+            hashtable_t *t = hashtable_create();
+            hashtable_resize(t, (uint32_t) capacity);
+            double start = bench_now();
+            for (size_t i = 0; i < n; i++)
+                hashtable_set(t, keys[i], keys[i]);
+            double mid = bench_now();
+            for (size_t i = 0; i < n; i++)
+                bench_sink(hashtable_get(t, keys[i]));
+            double end = bench_now();
+            for (size_t i = 0; i < n; i++)
+                bench_sink(hashtable_get(t, misses[i]));
+            miss += bench_now() - end;
+            hit += end - mid;
+            insert += mid - start;
+            if (t->capacity != capacity)
+                fprintf(stderr, "table grew, raise HT_MAX_LOAD\n");
+            hashtable_destroy(t);
+        }
+        double ops = (double) n * rounds / 1e9;
+        printf("%6.2f %10.1f %10.1f %10.1f\n", loads[l], insert / ops, hit / ops, miss / ops);
+    }
+    for (size_t i = 0; i < capacity; i++) {
+        free(keys[i]);
+        free(misses[i]);
+    }
+    free(keys);
+    free(misses);
+    return 0;
+}
@@ -0,0 +1,165 @@
+/*
+ * Copyright 2017 Francesco Circhetta
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * Throughput of hashtable_get() from 1 to N reader threads, on a table of
+ * the given number of keys. With the CONCURRENT engine every run is done
+ * again next to a writer setting and removing keys of its own, which also
+ * grows and shrinks the table under the readers; other engines only take
+ * the read-only runs, as a baseline.
+ *
+ * usage: bench-scaling-<variant> [keys] [max threads] [seconds per run]
+ */
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+#define _POSIX_C_SOURCE 200809L
+
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "bench.h"
+#include "utils.h"
+#include "hashtable.h"
+
+/****************************************************************************
+ * Private Types
+ ****************************************************************************/
+typedef struct _worker {
+    pthread_t           thread;
+    size_t              first;          /* Key the worker starts from */
+    size_t              ops;
+} worker_t;
+
+/****************************************************************************
+ * Private Data
+ ****************************************************************************/
+static hashtable_t *table;
+static char **keys, **extra;
+static size_t count;
+static int stop;
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+static void *read_loop(void *arg) {
+    worker_t *w = arg;
+    size_t i = w->first, ops = 0;
+    while (!__atomic_load_n(&stop, __ATOMIC_RELAXED)) {
+        for (int n = 0; n < 1024; n++) {
+            bench_sink(hashtable_get(table, keys[i]));
+            if (++i == count)
+                i = 0;
+        }
+        ops += 1024;
+    }
+    w->ops = ops;
+    return NULL;
+}
+
+/**
+ * Set and then remove all the extra keys, over and over
+ */
+static void *write_loop(void *arg) {
+    worker_t *w = arg;
+    size_t ops = 0;
+    while (!__atomic_load_n(&stop, __ATOMIC_RELAXED)) {
+        for (size_t i = 0; i < count; i++)
+            hashtable_set(table, extra[i], &extra[i]);
+        for (size_t i = 0; i < count; i++)
+            hashtable_remove(table, extra[i]);
+        ops += 2 * count;
+    }
+    w->ops = ops;
+    return NULL;
+}
+
+/**
+ * Run the given number of readers (and a writer) for the given time, return
+ * the reads per second. The writer's operations per second go to *writes.
+ */
+static double run(int threads, bool writer, double seconds, double *writes) {
+    worker_t *workers = malloc_or_die((threads + 1) * sizeof(worker_t));
+    struct timespec pause = {(time_t) seconds, (long) ((seconds - (long) seconds) * 1e9)};
+    stop = 0;
+    double start = bench_now();
+    for (int i = 0; i < threads; i++) {
+        workers[i].first = count / threads * i;
+        pthread_create(&workers[i].thread, NULL, read_loop, &workers[i]);
+    }
+    if (writer)
+        pthread_create(&workers[threads].thread, NULL, write_loop, &workers[threads]);
+    nanosleep(&pause, NULL);
+    __atomic_store_n(&stop, 1, __ATOMIC_RELAXED);
+    size_t ops = 0;
+    for (int i = 0; i < threads; i++) {
+        pthread_join(workers[i].thread, NULL);
+        ops += workers[i].ops;
+    }
+    if (writer)
+        pthread_join(workers[threads].thread, NULL);
+    double elapsed = bench_now() - start;
+    *writes = writer ? workers[threads].ops / elapsed : 0;
+    free(workers);
+    return ops / elapsed;
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+int main(int argc, char **argv) {
+    count = argc > 1 ? (size_t) atol(argv[1]) : 100000;
+    int max_threads = argc > 2 ? atoi(argv[2]) : (int) sysconf(_SC_NPROCESSORS_ONLN);
+    double seconds = argc > 3 ? atof(argv[3]) : 0.5;
+    bool writer = HT_ENGINE == HT_ENGINE_CONCURRENT;
+    table = hashtable_create();
+    keys = malloc_or_die(count * sizeof(char *));
+    extra = malloc_or_die(count * sizeof(char *));
+    for (size_t i = 0; i < count; i++) {
+        keys[i] = malloc_or_die(16);
+        extra[i] = malloc_or_die(16);
+        sprintf(keys[i], "file%zu", i);
+        sprintf(extra[i], "extra%zu", i);
+        hashtable_set(table, keys[i], &keys[i]);
+    }
+
+    printf("%zu keys, %.1f s per run\n", count, seconds);
+    printf("threads  reads/s   speedup%s\n",
+           writer ? "   with writer: reads/s   writes/s" : "");
+    double base = 0, writes;
+    for (int threads = 1; threads <= max_threads; threads++) {
+        double reads = run(threads, false, seconds, &writes);
+        if (threads == 1)
+            base = reads;
+        printf("%7d %8.2fM %8.2fx", threads, reads / 1e6, reads / base);
+        if (writer) {
+            reads = run(threads, true, seconds, &writes);
+            printf("                %8.2fM  %8.2fM", reads / 1e6, writes / 1e6);
+        }
+        printf("\n");
+    }
+
+    hashtable_destroy(table);
+    for (size_t i = 0; i < count; i++) {
+        free(keys[i]);
+        free(extra[i]);
+    }
+    free(keys);
+    free(extra);
+    return 0;
+}
@@ -0,0 +1,143 @@
+/*
+ * Copyright 2017 Francesco Circhetta
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * Large writes from a journal file, the way main.c reads them: a synthetic
+ * journal of one file written again and again with megabytes of content.
+ * Each mode is one run, so that maxrss is its own.
+ *  - getline: my_getline() from stdin, strtok() and a copy of the content
+ *  - copy: whole lines from a reader_t, and the same copy
+ *  - adopt: the content read into the buffer of the previous one, given
+ *    to the file
+ *
+ * usage: bench-write [-m megabytes] [-w writes] getline|copy|adopt
+ */
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+#include <unistd.h>
+
+#include "bench.h"
+#include "reader.h"
+#include "simplefs.h"
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+#define TOK_SPACE " \n\r\t"
+#define TOK_CONTENT "\"\n\r\t"
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+/**
+ * Journal of writes of megabytes each to /f, in a temporary file
+ */
+static FILE *make_journal(size_t megabytes, int writes) {
+    FILE *file = tmpfile();
+    if (file == NULL) {
+        fprintf(stderr, "cannot create the journal\n");
+        exit(1);
+    }
+    /* A megabyte at a time, not to count in maxrss */
+    char *content = malloc_or_die(1024 * 1024);
+    fputs("create /f\n", file);
+    for (int w = 0; w < writes; w++) {
+        memset(content, 'a' + w % 26, 1024 * 1024);
+        fputs("write /f \"", file);
+        for (size_t m = 0; m < megabytes; m++)
+            fwrite(content, 1, 1024 * 1024, file);
+        fputs("\"\n", file);
+    }
+    free(content);
+    fflush(file);
+    rewind(file);
+    return file;
+}
+
+/**
+ * Write a content copied out of a whole line
+ */
+static void write_line(node_t *root, char *line) {
+    if (strcmp(strtok(line, TOK_SPACE), "write") != 0)
+        return;
+    node_t *node = fs_find_in_dir(root, strtok(NULL, TOK_SPACE) + 1);
+    fs_set_file_content(node, strtok(NULL, TOK_CONTENT));
+    bench_sink(fs_get_file_content(node));
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+int main(int argc, char **argv) {
+    size_t megabytes = 100;
+    int writes = 5;
+    int opt;
+    while ((opt = getopt(argc, argv, "m:w:")) != -1) {
+        if (opt == 'm') megabytes = (size_t) atol(optarg);
+        else if (opt == 'w') writes = atoi(optarg);
+    }
+    const char *mode = optind < argc ? argv[optind] : "adopt";
+    FILE *journal = make_journal(megabytes, writes);
+    node_t *root = fs_new_root();
+    fs_create(root, "f", File);
+    char *line = NULL, *content = NULL;
+    size_t len = 0, capacity = 0;
+    long rss = bench_maxrss_kb();
+
+    double start = bench_now();
+    if (strcmp(mode, "getline") == 0) {
+        dup2(fileno(journal), STDIN_FILENO);
+        while (my_getline(&line, &len) >= 0)
+            write_line(root, line);
+    } else {
+        reader_t input;
+        reader_init(&input, fileno(journal));
+        int n;
+        while ((n = reader_getline(&input, &line, &len, 0, '"')) >= 0) {
+            if (line[n - 1] != '"')
+                continue;
+            if (strcmp(mode, "copy") == 0) {
+                reader_getline(&input, &line, &len, (size_t) n, '\n');
+                write_line(root, line);
+                continue;
+            }
+            node_t *node = fs_find_in_dir(root, "f");
+            char *old = fs_take_file_content(node, &capacity);
+            if (old != NULL) {
+                free(content);
+                content = old;
+            }
+            size_t size;
+            if (reader_getfield(&input, &content, &capacity, &size, TOK_CONTENT) != '\n')
+                reader_skipline(&input);
+            if (fs_adopt_file_content(node, content, size, capacity))
+                content = NULL;
+            bench_sink(fs_get_file_content(node));
+        }
+        reader_free(&input);
+    }
+    double elapsed = bench_now() - start;
+
+    printf("%-8s %6zu MB x %d %10.1f MB/s %12ld maxrss growth (KB)\n", mode, megabytes,
+           writes, (double) (megabytes * writes) / elapsed, bench_maxrss_kb() - rss);
+    free(line);
+    free(content);
+    fs_destroy_root(root);
+    fclose(journal);
+    return 0;
+}
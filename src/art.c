@@ -0,0 +1,687 @@
+/*
+ * Copyright 2017 Francesco Circhetta
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * Adaptive radix tree (Leis et al., ICDE 2013).
+ *
+ * A trie over the bytes of the keys, NUL terminator included so that no key
+ * is a prefix of another. Inner nodes come in four sizes, holding up to 4,
+ * 16, 48 or 256 children, and change size as children come and go; chains
+ * of single-child nodes are collapsed into a prefix. Node4 and Node16 keep
+ * their key bytes sorted and the other two are indexed by byte, so walking
+ * the children in order visits the keys in strcmp order. Leaves are the
+ * values themselves, tagged with the low bit of the pointer.
+ */
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "utils.h"
+#include "art.h"
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+/* Inner node types */
+#define ART_NODE4   0
+#define ART_NODE16  1
+#define ART_NODE48  2
+#define ART_NODE256 3
+
+#define ART_IS_LEAF(p) (((uintptr_t) (p)) & 1)
+#define ART_LEAF(v) ((void *) ((uintptr_t) (v) | 1))
+#define ART_VALUE(p) ((void *) ((uintptr_t) (p) & ~(uintptr_t) 1))
+#define ART_KEY(v) (*(const char **) ((char *) (v) + ART_KEY_OFFSET))
+
+#define ART_MIN(a, b) ((a) < (b) ? (a) : (b))
+
+/****************************************************************************
+ * Private Types
+ ****************************************************************************/
+typedef struct _art_node4 {
+    art_node_t          n;
+    unsigned char       keys[4];
+    void                *child[4];
+} art_node4_t;
+
+typedef struct _art_node16 {
+    art_node_t          n;
+    unsigned char       keys[16];
+    void                *child[16];
+} art_node16_t;
+
+typedef struct _art_node48 {
+    art_node_t          n;
+    uint8_t             index[256];     /* Child slot + 1 per byte */
+    void                *child[48];
+} art_node48_t;
+
+typedef struct _art_node256 {
+    art_node_t          n;
+    void                *child[256];
+} art_node256_t;
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+/**
+ * Allocate an empty inner node of the given type
+ */
+static art_node_t *art_node_new(uint8_t type) {
+    static const size_t sizes[] = {
+        sizeof(art_node4_t), sizeof(art_node16_t),
+        sizeof(art_node48_t), sizeof(art_node256_t)
+    };
+    art_node_t *n = calloc_or_die(1, sizes[type]);
+    n->type = type;
+    return n;
+}
+
+/**
+ * Copy count and prefix to a node replacing another one
+ */
+static void art_copy_header(art_node_t *dst, art_node_t *src) {
+    dst->count = src->count;
+    dst->prefix_len = src->prefix_len;
+    memcpy(dst->prefix, src->prefix, ART_MIN(src->prefix_len, ART_MAX_PREFIX));
+}
+
+/**
+ * Slot of the child for the given byte, or NULL
+ */
+static void **art_find_child(art_node_t *n, unsigned char c) {
+    switch (n->type) {
+    case ART_NODE4: {
+        art_node4_t *node = (art_node4_t *) n;
+        for (int i = 0; i < n->count; i++) {
+            if (node->keys[i] == c)
+                return &node->child[i];
+        }
+        return NULL;
+    }
+    case ART_NODE16: {
+        art_node16_t *node = (art_node16_t *) n;
+#ifdef __SSE2__
+        __m128i keys = _mm_loadu_si128((const __m128i *) node->keys);
+        int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(keys, _mm_set1_epi8((char) c)))
+                   & ((1 << n->count) - 1);
+        return mask ? &node->child[__builtin_ctz((unsigned int) mask)] : NULL;
+#else
+        for (int i = 0; i < n->count; i++) {
+            if (node->keys[i] == c)
+                return &node->child[i];
+        }
+        return NULL;
+#endif
+    }
+    case ART_NODE48: {
+        art_node48_t *node = (art_node48_t *) n;
+        return node->index[c] ? &node->child[node->index[c] - 1] : NULL;
+    }
+    default: {
+        art_node256_t *node = (art_node256_t *) n;
+        return node->child[c] ? &node->child[c] : NULL;
+    }
+    }
+}
+
+/**
+ * Child with the smallest byte not below *byte, which is updated to it.
+ * Return NULL if there is none.
+ */
+static void *art_child_from(art_node_t *n, int *byte) {
+    unsigned char *keys;
+    void **child;
+    switch (n->type) {
+    case ART_NODE4:
+        keys = ((art_node4_t *) n)->keys;
+        child = ((art_node4_t *) n)->child;
+        break;
+    case ART_NODE16:
+        keys = ((art_node16_t *) n)->keys;
+        child = ((art_node16_t *) n)->child;
+        break;
+    case ART_NODE48: {
+        art_node48_t *node = (art_node48_t *) n;
+        for (int b = *byte; b < 256; b++) {
+            if (node->index[b]) {
+                *byte = b;
+                return node->child[node->index[b] - 1];
+            }
+        }
+        return NULL;
+    }
+    default: {
+        art_node256_t *node = (art_node256_t *) n;
+        for (int b = *byte; b < 256; b++) {
+            if (node->child[b]) {
+                *byte = b;
+                return node->child[b];
+            }
+        }
+        return NULL;
+    }
+    }
+    for (int i = 0; i < n->count; i++) {
+        if (keys[i] >= *byte) {
+            *byte = keys[i];
+            return child[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Value with the smallest key below a node or leaf
+ */
+static void *art_minimum(void *n) {
+    while (!ART_IS_LEAF(n)) {
+        int b = 0;
+        n = art_child_from(n, &b);
+    }
+    return ART_VALUE(n);
+}
+
+/**
+ * Insert a child in the sorted arrays of a Node4 or Node16 with room left
+ */
+static void art_add_sorted(art_node_t *n, unsigned char *keys, void **children,
+                           unsigned char c, void *child) {
+    int i = 0;
+    while (i < n->count && keys[i] < c)
+        i++;
+    memmove(keys + i + 1, keys + i, (size_t) (n->count - i));
+    memmove(children + i + 1, children + i, (size_t) (n->count - i) * sizeof(void *));
+    keys[i] = c;
+    children[i] = child;
+    n->count++;
+}
+
+/**
+ * Add a child for a byte not in the node yet. A full node is replaced by
+ * the next larger type, through ref.
+ */
+static void art_add_child(void **ref, art_node_t *n, unsigned char c, void *child) {
+    switch (n->type) {
+    case ART_NODE4: {
+        art_node4_t *node = (art_node4_t *) n;
+        if (n->count < 4) {
+            art_add_sorted(n, node->keys, node->child, c, child);
+            return;
+        }
+        art_node16_t *big = (art_node16_t *) art_node_new(ART_NODE16);
+        art_copy_header(&big->n, n);
+        memcpy(big->keys, node->keys, 4);
+        memcpy(big->child, node->child, 4 * sizeof(void *));
+        *ref = big;
+        free(node);
+        art_add_sorted(&big->n, big->keys, big->child, c, child);
+        return;
+    }
+    case ART_NODE16: {
+        art_node16_t *node = (art_node16_t *) n;
+        if (n->count < 16) {
+            art_add_sorted(n, node->keys, node->child, c, child);
+            return;
+        }
+        art_node48_t *big = (art_node48_t *) art_node_new(ART_NODE48);
+        art_copy_header(&big->n, n);
+        for (int i = 0; i < 16; i++) {
+            big->index[node->keys[i]] = (uint8_t) (i + 1);
+            big->child[i] = node->child[i];
+        }
+        *ref = big;
+        free(node);
+        n = &big->n;
+    }
+    /* Fall through */
+    case ART_NODE48: {
+        art_node48_t *node = (art_node48_t *) n;
+        if (n->count < 48) {
+            int slot = 0;
+            while (node->child[slot] != NULL)
+                slot++;
+            node->child[slot] = child;
+            node->index[c] = (uint8_t) (slot + 1);
+            n->count++;
+            return;
+        }
+        art_node256_t *big = (art_node256_t *) art_node_new(ART_NODE256);
+        art_copy_header(&big->n, n);
+        for (int b = 0; b < 256; b++) {
+            if (node->index[b])
+                big->child[b] = node->child[node->index[b] - 1];
+        }
+        *ref = big;
+        free(node);
+        n = &big->n;
+    }
+    /* Fall through */
+    default:
+        ((art_node256_t *) n)->child[c] = child;
+        n->count++;
+    }
+}
+
+/**
+ * Replace a Node4 left with one child by that child, prepending the node
+ * prefix and the child byte to the prefix of an inner child.
+ */
+static void art_collapse(void **ref, art_node4_t *node) {
+    void *only = node->child[0];
+    if (!ART_IS_LEAF(only)) {
+        art_node_t *child = only;
+        unsigned char prefix[ART_MAX_PREFIX];
+        uint32_t stored = ART_MIN(node->n.prefix_len, ART_MAX_PREFIX);
+        memcpy(prefix, node->n.prefix, stored);
+        if (stored < ART_MAX_PREFIX)
+            prefix[stored++] = node->keys[0];
+        uint32_t more = ART_MIN(child->prefix_len, ART_MAX_PREFIX - stored);
+        memcpy(prefix + stored, child->prefix, more);
+        memcpy(child->prefix, prefix, stored + more);
+        child->prefix_len += node->n.prefix_len + 1;
+    }
+    *ref = only;
+    free(node);
+}
+
+/**
+ * Remove the child in the given slot. A node getting too sparse for its
+ * type is replaced by the next smaller one, through ref.
+ */
+static void art_remove_child(void **ref, art_node_t *n, unsigned char c, void **slot) {
+    switch (n->type) {
+    case ART_NODE4: {
+        art_node4_t *node = (art_node4_t *) n;
+        int i = (int) (slot - node->child);
+        memmove(node->keys + i, node->keys + i + 1, (size_t) (n->count - i - 1));
+        memmove(node->child + i, node->child + i + 1, (size_t) (n->count - i - 1) * sizeof(void *));
+        if (--n->count == 1)
+            art_collapse(ref, node);
+        return;
+    }
+    case ART_NODE16: {
+        art_node16_t *node = (art_node16_t *) n;
+        int i = (int) (slot - node->child);
+        memmove(node->keys + i, node->keys + i + 1, (size_t) (n->count - i - 1));
+        memmove(node->child + i, node->child + i + 1, (size_t) (n->count - i - 1) * sizeof(void *));
+        if (--n->count == 3) {
+            art_node4_t *small = (art_node4_t *) art_node_new(ART_NODE4);
+            art_copy_header(&small->n, n);
+            memcpy(small->keys, node->keys, 3);
+            memcpy(small->child, node->child, 3 * sizeof(void *));
+            *ref = small;
+            free(node);
+        }
+        return;
+    }
+    case ART_NODE48: {
+        art_node48_t *node = (art_node48_t *) n;
+        node->index[c] = 0;
+        *slot = NULL;
+        if (--n->count == 12) {
+            art_node16_t *small = (art_node16_t *) art_node_new(ART_NODE16);
+            art_copy_header(&small->n, n);
+            int j = 0;
+            for (int b = 0; b < 256; b++) {
+                if (node->index[b]) {
+                    small->keys[j] = (unsigned char) b;
+                    small->child[j++] = node->child[node->index[b] - 1];
+                }
+            }
+            *ref = small;
+            free(node);
+        }
+        return;
+    }
+    default: {
+        art_node256_t *node = (art_node256_t *) n;
+        *slot = NULL;
+        if (--n->count == 37) {
+            art_node48_t *small = (art_node48_t *) art_node_new(ART_NODE48);
+            art_copy_header(&small->n, n);
+            int j = 0;
+            for (int b = 0; b < 256; b++) {
+                if (node->child[b]) {
+                    small->child[j++] = node->child[b];
+                    small->index[b] = (uint8_t) j;
+                }
+            }
+            *ref = small;
+            free(node);
+        }
+    }
+    }
+}
+
+/**
+ * Number of leading bytes of the stored prefix matching the key at depth
+ */
+static uint32_t art_check_prefix(art_node_t *n, const char *key, size_t depth) {
+    uint32_t max = ART_MIN(n->prefix_len, ART_MAX_PREFIX), i;
+    for (i = 0; i < max; i++) {
+        if (n->prefix[i] != (unsigned char) key[depth + i])
+            break;
+    }
+    return i;
+}
+
+/**
+ * Number of leading bytes of the whole prefix matching the key at depth,
+ * reading the bytes past ART_MAX_PREFIX from a leaf below.
+ */
+static uint32_t art_prefix_mismatch(art_node_t *n, const char *key, size_t depth) {
+    uint32_t i = art_check_prefix(n, key, depth);
+    if (i < ART_MAX_PREFIX || n->prefix_len <= ART_MAX_PREFIX)
+        return i;
+    const char *leaf = ART_KEY(art_minimum(n));
+    for (; i < n->prefix_len; i++) {
+        if (leaf[depth + i] != key[depth + i])
+            break;
+    }
+    return i;
+}
+
+/**
+ * Insert a leaf for a value below the node in ref, whose keys share the
+ * first depth bytes with the given one.
+ */
+static bool art_insert_at(void **ref, void *value, const char *key, size_t depth) {
+    void *n = *ref;
+    if (n == NULL) {
+        *ref = ART_LEAF(value);
+        return true;
+    }
+    if (ART_IS_LEAF(n)) {
+        /* Split the leaf with a Node4 on the bytes the two keys share */
+        const char *other = ART_KEY(ART_VALUE(n));
+        if (strcmp(other + depth, key + depth) == 0)
+            return false;
+        uint32_t lcp = 0;
+        while (key[depth + lcp] == other[depth + lcp])
+            lcp++;
+        art_node_t *node = art_node_new(ART_NODE4);
+        node->prefix_len = lcp;
+        memcpy(node->prefix, key + depth, ART_MIN(lcp, ART_MAX_PREFIX));
+        *ref = node;
+        art_add_child(ref, node, (unsigned char) key[depth + lcp], ART_LEAF(value));
+        art_add_child(ref, node, (unsigned char) other[depth + lcp], n);
+        return true;
+    }
+    art_node_t *node = n;
+    if (node->prefix_len) {
+        uint32_t diff = art_prefix_mismatch(node, key, depth);
+        if (diff < node->prefix_len) {
+            /* Split the prefix with a Node4 where the key leaves it */
+            art_node_t *split = art_node_new(ART_NODE4);
+            unsigned char c;
+            split->prefix_len = diff;
+            memcpy(split->prefix, node->prefix, ART_MIN(diff, ART_MAX_PREFIX));
+            if (node->prefix_len <= ART_MAX_PREFIX) {
+                c = node->prefix[diff];
+                node->prefix_len -= diff + 1;
+                memmove(node->prefix, node->prefix + diff + 1, node->prefix_len);
+            } else {
+                const char *leaf = ART_KEY(art_minimum(node));
+                c = (unsigned char) leaf[depth + diff];
+                node->prefix_len -= diff + 1;
+                memcpy(node->prefix, leaf + depth + diff + 1,
+                       ART_MIN(node->prefix_len, ART_MAX_PREFIX));
+            }
+            *ref = split;
+            art_add_child(ref, split, c, node);
+            art_add_child(ref, split, (unsigned char) key[depth + diff], ART_LEAF(value));
+            return true;
+        }
+        depth += node->prefix_len;
+    }
+    void **slot = art_find_child(node, (unsigned char) key[depth]);
+    if (slot != NULL)
+        return art_insert_at(slot, value, key, depth + 1);
+    art_add_child(ref, node, (unsigned char) key[depth], ART_LEAF(value));
+    return true;
+}
+
+/**
+ * Remove the key from below the node in ref, return its value or NULL
+ */
+static void *art_remove_at(void **ref, const char *key, size_t len, size_t depth) {
+    void *n = *ref;
+    if (ART_IS_LEAF(n)) {
+        void *value = ART_VALUE(n);
+        if (strcmp(ART_KEY(value), key) != 0)
+            return NULL;
+        *ref = NULL;
+        return value;
+    }
+    art_node_t *node = n;
+    if (node->prefix_len) {
+        if (art_check_prefix(node, key, depth) != ART_MIN(node->prefix_len, ART_MAX_PREFIX))
+            return NULL;
+        depth += node->prefix_len;
+        if (depth >= len)
+            return NULL;
+    }
+    void **slot = art_find_child(node, (unsigned char) key[depth]);
+    if (slot == NULL)
+        return NULL;
+    if (ART_IS_LEAF(*slot)) {
+        void *value = ART_VALUE(*slot);
+        if (strcmp(ART_KEY(value), key) != 0)
+            return NULL;
+        art_remove_child(ref, node, (unsigned char) key[depth], slot);
+        return value;
+    }
+    return art_remove_at(slot, key, len, depth + 1);
+}
+
+/**
+ * Value with the smallest key greater than the given one below a node or
+ * leaf, whose keys share the first depth bytes with it. NULL if none.
+ */
+static void *art_next_at(void *n, const char *key, size_t depth) {
+    if (ART_IS_LEAF(n))
+        return strcmp(ART_KEY(ART_VALUE(n)), key) > 0 ? ART_VALUE(n) : NULL;
+    art_node_t *node = n;
+    if (node->prefix_len) {
+        /* Every key below sorts on the same side of the given one, unless
+         * the whole prefix matches */
+        const char *leaf = node->prefix_len > ART_MAX_PREFIX ? ART_KEY(art_minimum(node)) : NULL;
+        for (uint32_t i = 0; i < node->prefix_len; i++) {
+            unsigned char p = leaf ? (unsigned char) leaf[depth + i] : node->prefix[i];
+            unsigned char k = (unsigned char) key[depth + i];
+            if (p != k)
+                return p > k ? art_minimum(node) : NULL;
+        }
+        depth += node->prefix_len;
+    }
+    int c = (unsigned char) key[depth], b = c;
+    void *child;
+    while ((child = art_child_from(node, &b)) != NULL) {
+        void *value = b == c ? art_next_at(child, key, depth + 1) : art_minimum(child);
+        if (value != NULL)
+            return value;
+        b++;
+    }
+    return NULL;
+}
+
+/**
+ * Call fn on every value below a node or leaf, in key order
+ */
+static void art_walk_at(void *n, void (*fn)(void *, void *), void *arg) {
+    if (ART_IS_LEAF(n)) {
+        fn(ART_VALUE(n), arg);
+        return;
+    }
+    art_node_t *node = n;
+    switch (node->type) {
+    case ART_NODE4:
+        for (int i = 0; i < node->count; i++)
+            art_walk_at(((art_node4_t *) node)->child[i], fn, arg);
+        break;
+    case ART_NODE16:
+        for (int i = 0; i < node->count; i++)
+            art_walk_at(((art_node16_t *) node)->child[i], fn, arg);
+        break;
+    case ART_NODE48: {
+        art_node48_t *node48 = (art_node48_t *) node;
+        for (int b = 0; b < 256; b++) {
+            if (node48->index[b])
+                art_walk_at(node48->child[node48->index[b] - 1], fn, arg);
+        }
+        break;
+    }
+    default: {
+        art_node256_t *node256 = (art_node256_t *) node;
+        for (int b = 0; b < 256; b++) {
+            if (node256->child[b])
+                art_walk_at(node256->child[b], fn, arg);
+        }
+    }
+    }
+}
+
+/**
+ * Free the inner nodes below a node or leaf
+ */
+static void art_destroy_at(void *n) {
+    if (n == NULL || ART_IS_LEAF(n))
+        return;
+    int b = 0;
+    void *child;
+    while ((child = art_child_from(n, &b)) != NULL) {
+        art_destroy_at(child);
+        b++;
+    }
+    free(n);
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+/**
+ * Create a new, empty tree
+ */
+art_tree_t *art_create(void) {
+    art_tree_t *t = malloc_or_die(sizeof(art_tree_t));
+    t->root = NULL;
+    t->size = 0;
+    return t;
+}
+
+/**
+ * Return the value with the given key, or NULL if not found.
+ * Stored prefixes are only checked up to ART_MAX_PREFIX bytes on the way
+ * down, the leaf found is compared as a whole.
+ */
+void *art_get(art_tree_t *t, const char *key) {
+    size_t len = strlen(key) + 1, depth = 0;
+    void *n = t->root;
+    while (n != NULL) {
+        if (ART_IS_LEAF(n)) {
+            void *value = ART_VALUE(n);
+            return strcmp(ART_KEY(value), key) == 0 ? value : NULL;
+        }
+        art_node_t *node = n;
+        if (node->prefix_len) {
+            if (art_check_prefix(node, key, depth) != ART_MIN(node->prefix_len, ART_MAX_PREFIX))
+                return NULL;
+            depth += node->prefix_len;
+            if (depth >= len)
+                return NULL;
+        }
+        void **slot = art_find_child(node, (unsigned char) key[depth++]);
+        n = slot ? *slot : NULL;
+    }
+    return NULL;
+}
+
+/**
+ * Insert a value under the key it points to.
+ * Return false if the key is already taken.
+ */
+bool art_insert(art_tree_t *t, void *value) {
+    if (!art_insert_at(&t->root, value, ART_KEY(value), 0))
+        return false;
+    t->size++;
+    return true;
+}
+
+/**
+ * Remove a key from the tree, return its value or NULL if not found
+ */
+void *art_remove(art_tree_t *t, const char *key) {
+    if (t->root == NULL)
+        return NULL;
+    void *value = art_remove_at(&t->root, key, strlen(key) + 1, 0);
+    if (value != NULL)
+        t->size--;
+    return value;
+}
+
+/**
+ * Return the value with the smallest key greater than the given one (which
+ * does not need to be in the tree), the smallest of all if key is NULL.
+ * NULL if there is none.
+ */
+void *art_next(art_tree_t *t, const char *key) {
+    if (t->root == NULL)
+        return NULL;
+    return key == NULL ? art_minimum(t->root) : art_next_at(t->root, key, 0);
+}
+
+/**
+ * Iterate through the values in key order (the state holds the last value
+ * returned, which must not be removed in the meantime)
+ * Return NULL if no other value is present
+ */
+void *art_iterate(art_tree_t *t, size_t *state) {
+    void *value = art_next(t, *state ? ART_KEY((void *) *state) : NULL);
+    *state = (size_t) value;
+    return value;
+}
+
+/**
+ * Call fn(value, arg) on every value in key order, without the lookups of
+ * art_iterate(). fn must not modify the tree.
+ */
+void art_walk(art_tree_t *t, void (*fn)(void *, void *), void *arg) {
+    if (t->root != NULL)
+        art_walk_at(t->root, fn, arg);
+}
+
+/**
+ * Destroy the tree and deallocate it from memory. This does not deallocate the contained values.
+ */
+void art_destroy(art_tree_t *t) {
+    art_destroy_at(t->root);
+    free(t);
+}
+
+/**
+ * Return the number of values
+ */
+uint32_t art_get_size(art_tree_t *t) {
+    return t->size;
+}
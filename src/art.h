@@ -0,0 +1,72 @@
+/*
+ * Copyright 2017 Francesco Circhetta
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef API_ART_H
+#define API_ART_H
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+/* Like keyless hashtables, trees do not store keys: values must hold a
+ * pointer to their own NUL-terminated key ART_KEY_OFFSET bytes in, like the
+ * name of a node_t, and be at least 2-byte aligned. */
+#ifndef ART_KEY_OFFSET
+#define ART_KEY_OFFSET 0
+#endif
+
+/* Prefix bytes stored in an inner node, longer prefixes are checked on the
+ * leaf at the end of the lookup */
+#define ART_MAX_PREFIX 8
+
+/****************************************************************************
+ * Public Types
+ ****************************************************************************/
+/* Header of the inner nodes, each type adds its keys and children */
+typedef struct _art_node {
+    uint8_t             type;           /* ART_NODE4 ... ART_NODE256 */
+    uint16_t            count;          /* Children */
+    uint32_t            prefix_len;     /* Bytes shared by every key below */
+    unsigned char       prefix[ART_MAX_PREFIX];
+} art_node_t;
+
+/* Adaptive radix tree, sorted by key */
+typedef struct _art_tree {
+    void                *root;          /* Inner node, tagged leaf or NULL */
+    uint32_t            size;
+} art_tree_t;
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+uint32_t art_get_size(art_tree_t *);
+art_tree_t *art_create(void);
+void *art_get(art_tree_t *, const char *);
+bool art_insert(art_tree_t *, void *);
+void *art_remove(art_tree_t *, const char *);
+void *art_next(art_tree_t *, const char *);
+void *art_iterate(art_tree_t *, size_t *);
+void art_walk(art_tree_t *, void (*)(void *, void *), void *);
+void art_destroy(art_tree_t *);
+
+#endif //API_ART_H
@@ -0,0 +1,126 @@
+/*
+ * Copyright 2017 Francesco Circhetta
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * Content-addressed store of file contents.
+ *
+ * Contents are looked up by their hash, length and bytes, and each distinct
+ * one is stored once with a reference count. Files share the record
+ * read-only: rewriting a file releases its content and acquires the new
+ * one, so that the others keep theirs (copy on write, with whole-file
+ * writes only).
+ */
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+#include <string.h>
+
+#include "utils.h"
+#include "hash.h"
+#include "simplefs.h"
+#include "content.h"
+
+/****************************************************************************
+ * Private Types
+ ****************************************************************************/
+/* Key of a record, with its hash computed once */
+typedef struct _content_key {
+    const char          *data;
+    uint32_t            len;
+    uint64_t            hash;
+} content_key_t;
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+/* content_table_t, the records by content */
+#define HT_T_NAME content_table
+#define HT_T_KEY content_key_t
+#define HT_T_VALUE content_t *
+#define HT_T_KEY_OF(record) ((content_key_t) { (record)->data, (record)->len, (record)->hash })
+#define HT_T_HASH(k) ((k).hash)
+#define HT_T_EQUAL(a, b) ((a).len == (b).len && ((a).data == (b).data || memcmp((a).data, (b).data, (a).len) == 0))
+#include "hashtable_template.h"
+
+/****************************************************************************
+ * Private Data
+ ****************************************************************************/
+/* Allocated on the first content */
+static content_table_t contents = { 0, 0, NULL };
+/* Bytes of the records, sum of the references and of the bytes they would
+ * copy */
+static size_t stored_bytes = 0;
+static size_t references = 0;
+static size_t copied_bytes = 0;
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+/**
+ * Return the stored copy of a content of len bytes, storing it if needed,
+ * and take a reference to it. Return NULL if len does not fit a record.
+ */
+const char *content_acquire(const char *data, size_t len) {
+    if (len > UINT32_MAX)
+        return NULL;
+    if (contents.body == NULL)
+        content_table_init(&contents);
+    content_key_t key = { data, (uint32_t) len, hash_string(data, len) };
+    content_t **found = content_table_find(&contents, key);
+    content_t *record;
+    if (found != NULL) {
+        record = *found;
+    } else {
+        record = malloc_or_die(sizeof(content_t) + len + 1);
+        record->refs = 0;
+        record->len = key.len;
+        record->hash = key.hash;
+        memcpy(record->data, data, len);
+        record->data[len] = '\0';
+        content_table_set(&contents, key, record);
+        stored_bytes += sizeof(content_t) + len + 1;
+    }
+    record->refs++;
+    references++;
+    copied_bytes += FILE_BUFFER_SIZE(len);
+    return record->data;
+}
+
+/**
+ * Drop a reference to a stored content, which is freed with the last one
+ */
+void content_release(const char *data) {
+    content_t *record = content_record(data);
+    references--;
+    copied_bytes -= FILE_BUFFER_SIZE(record->len);
+    if (--record->refs == 0) {
+        content_key_t key = { record->data, record->len, record->hash };
+        content_table_remove(&contents, key);
+        stored_bytes -= sizeof(content_t) + record->len + 1;
+        free(record);
+        if (contents.size == 0)
+            content_table_release(&contents);
+    }
+}
+
+/**
+ * Return what the store holds and saves
+ */
+content_stats_t content_get_stats(void) {
+    content_stats_t stats = { contents.size, references, stored_bytes, copied_bytes };
+    return stats;
+}
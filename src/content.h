@@ -0,0 +1,65 @@
+/*
+ * Copyright 2017 Francesco Circhetta
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef API_CONTENT_H
+#define API_CONTENT_H
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+#include <stdint.h>
+#include <stddef.h>
+
+/****************************************************************************
+ * Public Types
+ ****************************************************************************/
+/* A stored file content, shared by every file holding the same bytes and
+ * never written while shared: a file given another content drops its
+ * reference instead. Files point to data, the record is right before. */
+typedef struct _content {
+    uint32_t            refs;
+    uint32_t            len;
+    uint64_t            hash;           /* hash_string() of data */
+    char                data[];
+} content_t;
+
+/* What the store holds against what separate copies would take */
+typedef struct _content_stats {
+    size_t              contents;       /* Distinct contents */
+    size_t              references;     /* Files holding one */
+    size_t              bytes;          /* Of the records */
+    size_t              copied_bytes;   /* Of a file_buffer_t per reference */
+} content_stats_t;
+
+/****************************************************************************
+ * Inline Functions
+ ****************************************************************************/
+/**
+ * Record of a stored content
+ */
+static inline content_t *content_record(const char *data) {
+    return (content_t *) (data - offsetof(content_t, data));
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+const char *content_acquire(const char *, size_t);
+void content_release(const char *);
+content_stats_t content_get_stats(void);
+
+#endif //API_CONTENT_H
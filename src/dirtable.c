@@ -0,0 +1,158 @@
+/*
+ * Copyright 2017 Francesco Circhetta
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * Global directory table.
+ *
+ * With FS_DIR_GLOBAL the entries of every directory live in this one linear
+ * probing table, keyed by (parent, name), instead of a table or a small
+ * array per directory: every step of a path walk probes the same, hot
+ * array. It is an instance of hashtable_template.h whose entries hold a
+ * child and its hash only, the parent and the name are read through the
+ * child. Bodies of 2 MB and more are aligned to, and advised as, huge pages
+ * where the system has them.
+ */
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+#ifdef __linux__
+#define _DEFAULT_SOURCE /* posix_memalign(), madvise() */
+#include <sys/mman.h>
+#endif
+#include <string.h>
+
+#include "utils.h"
+#include "hash.h"
+#include "dirtable.h"
+#include "intern.h"
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+#define DT_HUGE_PAGE (2 * 1024 * 1024)
+
+/****************************************************************************
+ * Private Types
+ ****************************************************************************/
+typedef struct _dirtable_key {
+    node_t              *parent;
+    const char          *name;
+} dirtable_key_t;
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+/**
+ * Hash of a name in a directory. The name hash is seeded, the parent
+ * address folded in is not known in advance either.
+ */
+static inline uint32_t dirtable_hash(dirtable_key_t key) {
+#ifdef FS_INTERN_NAMES
+    uint64_t h = intern_hash(key.name);
+#else
+    uint64_t h = hash_string(key.name, strlen(key.name));
+#endif
+    return (uint32_t) (h ^ (((uint64_t) (uintptr_t) key.parent * 0x9E3779B97F4A7C15ULL) >> 32));
+}
+
+/**
+ * Allocate an empty body, on huge pages if it is large enough
+ */
+static void *dirtable_body_allocate(size_t bytes) {
+#ifdef MADV_HUGEPAGE
+    if (bytes >= DT_HUGE_PAGE) {
+        void *body;
+        if (posix_memalign(&body, DT_HUGE_PAGE, bytes) != 0)
+            exit(-1);
+        madvise(body, bytes, MADV_HUGEPAGE);
+        return memset(body, 0, bytes);
+    }
+#endif
+    return calloc_or_die(1, bytes);
+}
+
+/* dirtable_entries_t: being shared, the table gets emptied and refilled by
+ * whole subtrees at once, it only shrinks at a quarter of HT_MIN_LOAD */
+#define HT_T_NAME dirtable_entries
+#define HT_T_KEY dirtable_key_t
+#define HT_T_VALUE node_t *
+#define HT_T_KEY_OF(child) ((dirtable_key_t) { (child)->parent, (child)->name })
+#define HT_T_HASH(k) dirtable_hash(k)
+#ifdef FS_INTERN_NAMES
+#define HT_T_EQUAL(a, b) ((a).parent == (b).parent && (a).name == (b).name)
+#else
+#define HT_T_EQUAL(a, b) ((a).parent == (b).parent && strcmp((a).name, (b).name) == 0)
+#endif
+#define HT_T_INITIAL_CAPACITY 1024
+#define HT_T_MAX_LOAD HT_MAX_LOAD
+#define HT_T_MIN_LOAD (HT_MIN_LOAD / 4)
+#define HT_T_ALLOC(bytes) dirtable_body_allocate(bytes)
+#include "hashtable_template.h"
+
+/****************************************************************************
+ * Private Data
+ ****************************************************************************/
+/* Allocated on the first entry */
+static dirtable_entries_t dt = { 0, 0, NULL };
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+/**
+ * Return the child of parent with the given name, or NULL if not found.
+ */
+node_t *dirtable_get(node_t *parent, const char *name) {
+    if (dt.size == 0)
+        return NULL;
+    dirtable_key_t key = { parent, name };
+    node_t **child = dirtable_entries_find(&dt, key);
+    return child != NULL ? *child : NULL;
+}
+
+/**
+ * Add a child under its parent and name.
+ * Return false if the name is already taken in that directory.
+ */
+bool dirtable_add(node_t *child) {
+    if (dt.body == NULL)
+        dirtable_entries_init(&dt);
+    dirtable_key_t key = { child->parent, child->name };
+    return dirtable_entries_set(&dt, key, child);
+}
+
+/**
+ * Remove a child
+ */
+void dirtable_remove(node_t *child) {
+    dirtable_key_t key = { child->parent, child->name };
+    dirtable_entries_remove(&dt, key);
+}
+
+/**
+ * Return the number of entries, of all directories
+ */
+uint32_t dirtable_get_size(void) {
+    return dt.size;
+}
+
+/**
+ * Return the number of slots
+ */
+uint32_t dirtable_get_capacity(void) {
+    return dt.capacity;
+}
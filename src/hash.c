@@ -0,0 +1,470 @@
+/*
+ * Copyright 2017 Francesco Circhetta
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * String hash functions.
+ *
+ * hash_string() is the one used by the tables, chosen at build time through
+ * HASH_FN; the others stay available for comparison. Every function takes
+ * the key length from the caller and loads words through memcpy(), so keys
+ * need no particular alignment. Words are read in host byte order: hash
+ * values are not portable across architectures, and need not be.
+ *
+ * The seed of hash_string() is drawn at random once per process, so that
+ * names colliding in one run do not collide in the next: a journal cannot
+ * be crafted to degrade every lookup of a directory into a full scan.
+ * Builds defining HASH_FIXED_SEED, and hash_set_seed(), make it
+ * deterministic again.
+ */
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#ifdef __SSE4_2__
+#include <nmmintrin.h>
+#endif
+
+#include "hash.h"
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+#define HASH_RANDOM_SOURCE "/dev/urandom"
+
+#define XXH_PRIME32_1 0x9E3779B1ULL
+#define XXH_PRIME64_1 0x9E3779B185EBCA87ULL
+#define XXH_PRIME64_2 0xC2B2AE3D27D4EB4FULL
+
+/* Lanes of a stripe, and stripes accumulated between two scrambles */
+#define XXH_STRIPE_LANES 8
+#define XXH_BLOCK_STRIPES 16
+#define XXH_STRIPE_LEN (XXH_STRIPE_LANES * 8)
+#define XXH_MIDSIZE_MAX 240
+
+#define CRC32C_POLY 0x82F63B78U
+
+/****************************************************************************
+ * Private Data
+ ****************************************************************************/
+/* The first hash may happen on any thread, the concurrent engine's readers
+ * included: hash_seeded goes from SEED_NONE to SEED_PICKING for the one
+ * thread picking the seed, others wait for SEED_READY, and hash_seed is
+ * read only once it is released */
+enum { SEED_NONE, SEED_PICKING, SEED_READY };
+static uint64_t hash_seed;
+static int hash_seeded = SEED_NONE;
+
+/* wyhash default secret */
+static const uint64_t wy_secret[4] = {
+    0xa0761d6478bd642fULL, 0xe7037ed1a0b428dbULL,
+    0x8ebc6af09c88c6e3ULL, 0x589965cc75374cc3ULL,
+};
+
+/* Secret of the XXH3-style hash, splitmix64 output: 16 stripe offsets of 8
+ * lanes, the last 8 words also scramble the accumulators */
+static const uint64_t xxh_secret[XXH_STRIPE_LANES + XXH_BLOCK_STRIPES] = {
+    0x5fdff58cf104add0ULL, 0xbcb4675e3666371bULL, 0x99f98ab10bd7db93ULL,
+    0xc9bc251130ad4c00ULL, 0x4a53a878bc5a7d7dULL, 0x53457bbc1cfcd1d4ULL,
+    0x96da1fe1d07a5c23ULL, 0x1fe0ddc4b8313716ULL, 0x654cc5389a85ccd4ULL,
+    0xd1fa282d249d8c56ULL, 0xb1222d24fbc9a426ULL, 0x869485728123976fULL,
+    0x78583666eab5a14cULL, 0x9513f237252aabd4ULL, 0x692ecb35f2821dfaULL,
+    0xfc0b21bf92234a05ULL, 0xffbe290cc237ec9dULL, 0x378424b0323a1beeULL,
+    0x0964db2e981d20f5ULL, 0xeccf0057231aff20ULL, 0x86d0f23bf77afa38ULL,
+    0x5c71c59e13182817ULL, 0x33c84348b04864cbULL, 0xa971e9a64cfcddd1ULL,
+};
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+static inline uint64_t read64(const unsigned char *p) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint64_t read32(const unsigned char *p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+/**
+ * Full 128 bit product of a and b, low half in a and high half in b.
+ */
+static inline void mul_wide(uint64_t *a, uint64_t *b) {
+#ifdef __SIZEOF_INT128__
+    __extension__ unsigned __int128 r = (unsigned __int128) *a * *b;
+    *a = (uint64_t) r;
+    *b = (uint64_t) (r >> 64);
+#else
+    uint64_t lo_lo = (*a & 0xFFFFFFFF) * (*b & 0xFFFFFFFF);
+    uint64_t hi_lo = (*a >> 32) * (*b & 0xFFFFFFFF);
+    uint64_t lo_hi = (*a & 0xFFFFFFFF) * (*b >> 32);
+    uint64_t hi_hi = (*a >> 32) * (*b >> 32);
+    uint64_t cross = (lo_lo >> 32) + (hi_lo & 0xFFFFFFFF) + lo_hi;
+    *a = (cross << 32) | (lo_lo & 0xFFFFFFFF);
+    *b = hi_hi + (hi_lo >> 32) + (cross >> 32);
+#endif
+}
+
+/**
+ * 128 bit product of a and b, folded to 64 bits.
+ */
+static inline uint64_t mul_fold(uint64_t a, uint64_t b) {
+    mul_wide(&a, &b);
+    return a ^ b;
+}
+
+/**
+ * splitmix64 finalizer, to spread weak entropy over the whole word.
+ */
+static inline uint64_t mix64(uint64_t z) {
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+/**
+ * Pick the process seed: HASH_FIXED_SEED if defined, else random bytes from
+ * the system, else the clock and the stack address (randomized by ASLR).
+ */
+static uint64_t hash_seed_pick(void) {
+    uint64_t seed;
+#ifdef HASH_FIXED_SEED
+    seed = (uint64_t) (HASH_FIXED_SEED);
+#else
+    FILE *random = fopen(HASH_RANDOM_SOURCE, "rb");
+    if (random == NULL || fread(&seed, sizeof(seed), 1, random) != 1) {
+        uintptr_t stack = (uintptr_t) &random;
+        seed = mix64((uint64_t) time(NULL) ^ ((uint64_t) clock() << 32) ^ mix64(stack));
+    }
+    if (random != NULL)
+        fclose(random);
+#endif
+    return seed;
+}
+
+/**
+ * Return the process seed, picked by the first thread to ask for it
+ */
+static inline uint64_t hash_seed_get(void) {
+    if (__atomic_load_n(&hash_seeded, __ATOMIC_ACQUIRE) != SEED_READY) {
+        int state = SEED_NONE;
+        if (__atomic_compare_exchange_n(&hash_seeded, &state, SEED_PICKING, false,
+                                        __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE)) {
+            hash_seed = hash_seed_pick();
+            __atomic_store_n(&hash_seeded, SEED_READY, __ATOMIC_RELEASE);
+        } else {
+            /* Another thread is picking it, which takes one read */
+            while (__atomic_load_n(&hash_seeded, __ATOMIC_ACQUIRE) != SEED_READY)
+                ;
+        }
+    }
+    return hash_seed;
+}
+
+static inline uint64_t xxh_avalanche(uint64_t h) {
+    h ^= h >> 37;
+    h *= 0x165667919E3779F9ULL;
+    h ^= h >> 32;
+    return h;
+}
+
+/**
+ * Mix 16 bytes of input with two secret words.
+ */
+static inline uint64_t xxh_mix16(const unsigned char *p, const uint64_t *secret,
+                                 uint64_t seed) {
+    return mul_fold(read64(p) ^ (secret[0] + seed), read64(p + 8) ^ (secret[1] - seed));
+}
+
+/**
+ * Add a 64 byte stripe to the accumulators: every lane adds the product of
+ * the two halves of its keyed input, and its plain input to the next lane.
+ */
+static inline void xxh_accumulate(uint64_t *acc, const unsigned char *p,
+                                  const uint64_t *secret) {
+#ifdef __SSE2__
+    for (unsigned int i = 0; i < XXH_STRIPE_LANES; i += 2) {
+        __m128i data = _mm_loadu_si128((const __m128i *) (p + i * 8));
+        __m128i key = _mm_xor_si128(data, _mm_loadu_si128((const __m128i *) (secret + i)));
+        __m128i key_hi = _mm_shuffle_epi32(key, _MM_SHUFFLE(0, 3, 0, 1));
+        __m128i product = _mm_mul_epu32(key, key_hi);
+        __m128i swapped = _mm_shuffle_epi32(data, _MM_SHUFFLE(1, 0, 3, 2));
+        __m128i a = _mm_loadu_si128((const __m128i *) (acc + i));
+        a = _mm_add_epi64(_mm_add_epi64(a, swapped), product);
+        _mm_storeu_si128((__m128i *) (acc + i), a);
+    }
+#else
+    for (unsigned int i = 0; i < XXH_STRIPE_LANES; i++) {
+        uint64_t data = read64(p + i * 8);
+        uint64_t key = data ^ secret[i];
+        acc[i ^ 1] += data;
+        acc[i] += (key & 0xFFFFFFFF) * (key >> 32);
+    }
+#endif
+}
+
+/**
+ * Shake the accumulators at the end of every block.
+ */
+static inline void xxh_scramble(uint64_t *acc, const uint64_t *secret) {
+#ifdef __SSE2__
+    const __m128i prime = _mm_set1_epi32((int) XXH_PRIME32_1);
+    for (unsigned int i = 0; i < XXH_STRIPE_LANES; i += 2) {
+        __m128i a = _mm_loadu_si128((const __m128i *) (acc + i));
+        a = _mm_xor_si128(a, _mm_srli_epi64(a, 47));
+        a = _mm_xor_si128(a, _mm_loadu_si128((const __m128i *) (secret + i)));
+        /* 64 by 32 bit multiplication out of two 32 by 32 bit ones */
+        __m128i lo = _mm_mul_epu32(a, prime);
+        __m128i hi = _mm_mul_epu32(_mm_shuffle_epi32(a, _MM_SHUFFLE(2, 3, 0, 1)), prime);
+        a = _mm_add_epi64(lo, _mm_slli_epi64(hi, 32));
+        _mm_storeu_si128((__m128i *) (acc + i), a);
+    }
+#else
+    for (unsigned int i = 0; i < XXH_STRIPE_LANES; i++) {
+        uint64_t a = acc[i];
+        a ^= a >> 47;
+        a ^= secret[i];
+        acc[i] = a * XXH_PRIME32_1;
+    }
+#endif
+}
+
+/**
+ * Long inputs: wide accumulators fed a stripe at a time.
+ */
+static uint64_t xxh_long(const unsigned char *p, size_t len, uint64_t seed) {
+    uint64_t acc[XXH_STRIPE_LANES] = {
+        XXH_PRIME32_1, XXH_PRIME64_1, XXH_PRIME64_2, seed,
+        ~seed, XXH_PRIME64_2, XXH_PRIME64_1, XXH_PRIME32_1,
+    };
+    size_t stripes = (len - 1) / XXH_STRIPE_LEN;
+    size_t s = 0;
+    for (; s + XXH_BLOCK_STRIPES <= stripes; s += XXH_BLOCK_STRIPES) {
+        for (unsigned int i = 0; i < XXH_BLOCK_STRIPES; i++)
+            xxh_accumulate(acc, p + (s + i) * XXH_STRIPE_LEN, xxh_secret + i);
+        xxh_scramble(acc, xxh_secret + XXH_BLOCK_STRIPES);
+    }
+    for (unsigned int i = 0; s + i < stripes; i++)
+        xxh_accumulate(acc, p + (s + i) * XXH_STRIPE_LEN, xxh_secret + i);
+    /* The last stripe overlaps the previous one */
+    xxh_accumulate(acc, p + len - XXH_STRIPE_LEN, xxh_secret + 7);
+
+    uint64_t h = len * XXH_PRIME64_1;
+    for (unsigned int i = 0; i < XXH_STRIPE_LANES; i += 2)
+        h += mul_fold(acc[i] ^ xxh_secret[i + 3], acc[i + 1] ^ xxh_secret[i + 4]);
+    return xxh_avalanche(h);
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+/**
+ * Compute the hash value for the given string of len bytes, with the
+ * function selected at build time and the process seed.
+ */
+uint64_t hash_string(const char *key, size_t len) {
+    uint64_t seed = hash_seed_get();
+#if HASH_FN == HASH_FN_WYHASH
+    return hash_wyhash(key, len, seed);
+#elif HASH_FN == HASH_FN_XXH3
+    return hash_xxh3(key, len, seed);
+#elif HASH_FN == HASH_FN_CRC32C
+    return hash_crc32c(key, len, seed);
+#else
+    return hash_murmur(key, len, seed);
+#endif
+}
+
+/**
+ * Replace the seed of hash_string(), e.g. for reproducible runs. Values
+ * hashed before are not valid anymore: call it before creating any table.
+ */
+void hash_set_seed(uint64_t seed) {
+    hash_seed = seed;
+    __atomic_store_n(&hash_seeded, SEED_READY, __ATOMIC_RELEASE);
+}
+
+/**
+ * Return the seed of hash_string().
+ */
+uint64_t hash_get_seed(void) {
+    return hash_seed_get();
+}
+
+/**
+ * MurmurHash64A.
+ */
+uint64_t hash_murmur(const char *key, size_t len, uint64_t seed) {
+    const uint64_t m = 0xc6a4a7935bd1e995ULL;
+    const int r = 47;
+    const unsigned char *data = (const unsigned char *) key;
+    const unsigned char *end = data + (len & ~(size_t) 7);
+    uint64_t h = seed ^ (len * m);
+    while (data != end) {
+        uint64_t k = read64(data);
+        data += 8;
+        k *= m;
+        k ^= k >> r;
+        k *= m;
+        h ^= k;
+        h *= m;
+    }
+    switch (len & 7) {
+        case 7: h ^= ((uint64_t) data[6]) << 48; /* fall through */
+        case 6: h ^= ((uint64_t) data[5]) << 40; /* fall through */
+        case 5: h ^= ((uint64_t) data[4]) << 32; /* fall through */
+        case 4: h ^= ((uint64_t) data[3]) << 24; /* fall through */
+        case 3: h ^= ((uint64_t) data[2]) << 16; /* fall through */
+        case 2: h ^= ((uint64_t) data[1]) << 8;  /* fall through */
+        case 1: h ^= ((uint64_t) data[0]);
+            h *= m;
+        default:
+            break;
+    }
+    h ^= h >> r;
+    h *= m;
+    h ^= h >> r;
+    return h;
+}
+
+/**
+ * wyhash (final version 4): 128 bit multiply-and-fold rounds over 16 byte
+ * chunks, up to 16 bytes read as overlapping words without any loop.
+ */
+uint64_t hash_wyhash(const char *key, size_t len, uint64_t seed) {
+    const unsigned char *p = (const unsigned char *) key;
+    uint64_t a, b;
+    seed ^= mul_fold(seed ^ wy_secret[0], wy_secret[1]);
+    if (len <= 16) {
+        if (len >= 4) {
+            size_t mid = (len >> 3) << 2;
+            a = (read32(p) << 32) | read32(p + mid);
+            b = (read32(p + len - 4) << 32) | read32(p + len - 4 - mid);
+        } else if (len > 0) {
+            a = ((uint64_t) p[0] << 16) | ((uint64_t) p[len >> 1] << 8) | p[len - 1];
+            b = 0;
+        } else {
+            a = b = 0;
+        }
+    } else {
+        size_t i = len;
+        if (i > 48) {
+            uint64_t see1 = seed, see2 = seed;
+            do {
+                seed = mul_fold(read64(p) ^ wy_secret[1], read64(p + 8) ^ seed);
+                see1 = mul_fold(read64(p + 16) ^ wy_secret[2], read64(p + 24) ^ see1);
+                see2 = mul_fold(read64(p + 32) ^ wy_secret[3], read64(p + 40) ^ see2);
+                p += 48;
+                i -= 48;
+            } while (i > 48);
+            seed ^= see1 ^ see2;
+        }
+        while (i > 16) {
+            seed = mul_fold(read64(p) ^ wy_secret[1], read64(p + 8) ^ seed);
+            i -= 16;
+            p += 16;
+        }
+        a = read64(p + i - 16);
+        b = read64(p + i - 8);
+    }
+    a ^= wy_secret[1];
+    b ^= seed;
+    mul_wide(&a, &b);
+    return mul_fold(a ^ wy_secret[0] ^ len, b ^ wy_secret[1]);
+}
+
+/**
+ * XXH3-style hash: dedicated branches for short keys, 16 byte mixes up to
+ * XXH_MIDSIZE_MAX bytes, then SIMD accumulation of 64 byte stripes (SSE2
+ * when available, with an equivalent scalar fallback).
+ */
+uint64_t hash_xxh3(const char *key, size_t len, uint64_t seed) {
+    const unsigned char *p = (const unsigned char *) key;
+    if (len > XXH_MIDSIZE_MAX)
+        return xxh_long(p, len, seed);
+    if (len > 16) {
+        uint64_t h = len * XXH_PRIME64_1;
+        size_t i = 0;
+        for (; i + 16 < len; i += 16)
+            h += xxh_mix16(p + i, xxh_secret + (i / 8) % XXH_BLOCK_STRIPES, seed);
+        h += xxh_mix16(p + len - 16, xxh_secret + XXH_BLOCK_STRIPES, seed);
+        return xxh_avalanche(h);
+    }
+    if (len > 8) {
+        uint64_t lo = read64(p) ^ (xxh_secret[2] + seed);
+        uint64_t hi = read64(p + len - 8) ^ (xxh_secret[3] - seed);
+        uint64_t h = len + ((lo << 32) | (lo >> 32)) + hi + mul_fold(lo, hi);
+        return xxh_avalanche(h);
+    }
+    if (len >= 4) {
+        uint64_t h = (read32(p + len - 4) | (read32(p) << 32)) ^ (xxh_secret[1] - seed);
+        h ^= (h << 49 | h >> 15) ^ (h << 24 | h >> 40);
+        h *= 0x9FB21C651E98DF25ULL;
+        h ^= (h >> 35) + len;
+        h *= 0x9FB21C651E98DF25ULL;
+        return h ^ (h >> 28);
+    }
+    if (len > 0) {
+        uint64_t c = ((uint64_t) p[0] << 16) | ((uint64_t) p[len >> 1] << 24)
+                     | p[len - 1] | ((uint64_t) len << 8);
+        return xxh_avalanche((c ^ (xxh_secret[0] + seed)) * XXH_PRIME64_1);
+    }
+    return xxh_avalanche(seed ^ xxh_secret[0] ^ xxh_secret[1]);
+}
+
+/**
+ * CRC32C of the key, through the SSE4.2 crc32 instruction when compiled in
+ * (bitwise otherwise), spread to 64 bits by a final multiply and fold.
+ * The hardware path ends with overlapping word reads rather than a byte
+ * loop, which is why the length is folded into the initial value.
+ */
+uint64_t hash_crc32c(const char *key, size_t len, uint64_t seed) {
+    const unsigned char *p = (const unsigned char *) key;
+    uint64_t crc = (uint32_t) ~(seed ^ len);
+#ifdef __SSE4_2__
+    if (len >= 8) {
+        const unsigned char *last = p + len - 8;
+        for (; p < last; p += 8)
+            crc = _mm_crc32_u64(crc, read64(p));
+        crc = _mm_crc32_u64(crc, read64(last));
+    } else if (len >= 4) {
+        crc = _mm_crc32_u32((uint32_t) crc, (uint32_t) read32(p));
+        crc = _mm_crc32_u32((uint32_t) crc, (uint32_t) read32(p + len - 4));
+    } else {
+        for (; len > 0; len--, p++)
+            crc = _mm_crc32_u8((uint32_t) crc, *p);
+    }
+#else
+    for (; len > 0; len--, p++) {
+        crc ^= *p;
+        for (unsigned int k = 0; k < 8; k++)
+            crc = (crc >> 1) ^ (CRC32C_POLY & (0 - (crc & 1)));
+    }
+#endif
+    /* A product carries upward only: fold its high half down, or the low
+     * bits tables index with would depend on the low crc bits alone */
+    uint64_t h = ((crc ^ 0xFFFFFFFF) | (crc << 32)) * XXH_PRIME64_1;
+    return h ^ (h >> 32);
+}
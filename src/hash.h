@@ -0,0 +1,52 @@
+/*
+ * Copyright 2017 Francesco Circhetta
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef API_HASH_H
+#define API_HASH_H
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+/* Hash functions hash_string() can be built with */
+#define HASH_FN_MURMUR 0
+#define HASH_FN_WYHASH 1
+#define HASH_FN_XXH3 2
+#define HASH_FN_CRC32C 3
+
+#ifndef HASH_FN
+#define HASH_FN HASH_FN_MURMUR
+#endif
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+uint64_t hash_string(const char *, size_t);
+void hash_set_seed(uint64_t);
+uint64_t hash_get_seed(void);
+uint64_t hash_murmur(const char *, size_t, uint64_t);
+uint64_t hash_wyhash(const char *, size_t, uint64_t);
+uint64_t hash_xxh3(const char *, size_t, uint64_t);
+uint64_t hash_crc32c(const char *, size_t, uint64_t);
+
+#endif //API_HASH_H
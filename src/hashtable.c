@@ -14,80 +14,324 @@
  * limitations under the License.
  */
 
+/**
+ * Linear probing engine.
+ *
+ * The plain engine is the hashtable_linear instance of hashtable_template.h
+ * declared in hashtable.h, behind the generic API. With
+ * HT_INCREMENTAL_RESIZE the table also tracks an old body being migrated,
+ * which the template knows nothing of: that variant is written out below.
+ */
+
 /****************************************************************************
  * Included Files
  ****************************************************************************/
 #include <string.h>
 
 #include "utils.h"
+#include "hash.h"
 #include "hashtable.h"
+#ifdef HT_INCREMENTAL_RESIZE
+#include "hashtable_internal.h"
+#endif
+#ifdef HT_STATS
+#include "hashtable_stats.h"
+#endif
 
+#ifndef HT_INCREMENTAL_RESIZE
+#ifdef HT_STATS
 /****************************************************************************
- * Pre-processor Definitions
+ * Private Functions
  ****************************************************************************/
-#define HT_INITIAL_CAPACITY 32
+/**
+ * Length of the run of used slots through the given one
+ */
+static uint32_t cluster_length(hashtable_t *t, size_t idx) {
+    size_t mask = (size_t) t->capacity - 1;
+    uint32_t length = 1;
+    for (size_t i = (idx - 1) & mask; t->body[i].hash != 0; i = (i - 1) & mask)
+        length++;
+    for (size_t i = (idx + 1) & mask; t->body[i].hash != 0; i = (i + 1) & mask)
+        length++;
+    return length;
+}
+
+/**
+ * Length of the longest run of used slots
+ */
+static uint32_t max_cluster(hashtable_t *t) {
+    size_t mask = (size_t) t->capacity - 1;
+    size_t start = 0;
+    uint32_t length = 0, longest = 0;
+    /* Start past an empty slot, so that no run wraps around */
+    while (t->body[start].hash != 0)
+        start++;
+    for (size_t i = 1; i <= mask; i++) {
+        if (t->body[(start + i) & mask].hash != 0) {
+            if (++length > longest)
+                longest = length;
+        } else {
+            length = 0;
+        }
+    }
+    return longest;
+}
+
+/**
+ * Count the slots an operation on the key probes, up to the one holding it
+ * or the empty slot ending its run
+ */
+static void stats_probes(hashtable_t *t, char *key, int op) {
+    uint32_t hash = hashtable_linear_hash_key(key);
+    size_t idx = (size_t) (hashtable_linear_find_slot(t, key, hash) - t->body);
+    hashtable_stats_probes(op, (uint32_t) (((idx - hash) & (t->capacity - 1)) + 1));
+}
+
+/**
+ * Account for an operation given the size and capacity of the table before
+ * it: entries added or removed, resizes, and the cluster of the new entry.
+ */
+static void stats_update(hashtable_t *t, char *key, uint32_t size, uint32_t capacity) {
+    if (t->capacity != capacity) {
+        uint32_t moved = size < t->size ? size : t->size;
+        hashtable_stats_resize(capacity, t->capacity);
+        hashtable_stats_moved((uint64_t) moved * sizeof(hashtable_entry_t));
+        hashtable_stats_cluster(max_cluster(t));
+    }
+    /* After the resize, so that a peak is counted against the slots that
+     * hold it */
+    hashtable_stats_entries((int) t->size - (int) size);
+    if (t->size > size) {
+        hashtable_entry_t *entry =
+                hashtable_linear_find_slot(t, key, hashtable_linear_hash_key(key));
+        hashtable_stats_cluster(cluster_length(t, (size_t) (entry - t->body)));
+    }
+}
+#endif
 
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+/**
+ * Create a new, empty hashtable
+ */
+hashtable_t *hashtable_create(void) {
+    hashtable_t *t = hashtable_linear_create();
+#ifdef HT_STATS
+    hashtable_stats_create(t->capacity);
+#endif
+    return t;
+}
+
+/**
+ * Return the item associated with the given key, or NULL if not found.
+ */
+void *hashtable_get(hashtable_t *table, char *key) {
+#ifdef HT_STATS
+    stats_probes(table, key, HT_STATS_GET);
+#endif
+    void **value = hashtable_linear_find(table, key);
+    return value != NULL ? *value : NULL;
+}
+
+/**
+ * Assign a value to the given key in the table.
+ */
+bool hashtable_set(hashtable_t *t, char *key, void *value) {
+#ifdef HT_STATS
+    uint32_t size = t->size, capacity = t->capacity;
+    stats_probes(t, key, HT_STATS_SET);
+    bool done = hashtable_linear_set(t, key, value);
+    stats_update(t, key, size, capacity);
+    return done;
+#else
+    return hashtable_linear_set(t, key, value);
+#endif
+}
+
+/**
+ * Resize the allocated memory to the given capacity (a power of two).
+ */
+void hashtable_resize(hashtable_t *t, uint32_t capacity) {
+#ifdef HT_STATS
+    uint32_t old_capacity = t->capacity;
+    hashtable_linear_resize(t, capacity);
+    stats_update(t, NULL, t->size, old_capacity);
+#else
+    hashtable_linear_resize(t, capacity);
+#endif
+}
+
+/**
+ * Remove a key from the table
+ * The table shrinks once it gets sparse.
+ */
+void hashtable_remove(hashtable_t *t, char *key) {
+#ifdef HT_STATS
+    uint32_t size = t->size, capacity = t->capacity;
+    stats_probes(t, key, HT_STATS_REMOVE);
+    hashtable_linear_remove(t, key);
+    stats_update(t, key, size, capacity);
+#else
+    hashtable_linear_remove(t, key);
+#endif
+}
+
+/**
+ * Shrink the table to the smallest capacity fitting its entries, e.g. after
+ * bulk removals.
+ */
+void hashtable_compact(hashtable_t *t) {
+#ifdef HT_STATS
+    uint32_t capacity = t->capacity;
+    hashtable_linear_compact(t);
+    stats_update(t, NULL, t->size, capacity);
+#else
+    hashtable_linear_compact(t);
+#endif
+}
+
+/**
+ * Iterate through table entries (uses only an int as state memory)
+ * Return NULL if no other element is present
+ */
+void *hashtable_iterate(hashtable_t *table, size_t *state) {
+    void **value = hashtable_linear_iterate(table, state);
+    return value != NULL ? *value : NULL;
+}
+
+/**
+ * Destroy the table and deallocate it from memory. This does not deallocate the contained items.
+ */
+void hashtable_destroy(hashtable_t *t) {
+#ifdef HT_STATS
+    hashtable_stats_destroy(t->size, t->capacity);
+#endif
+    hashtable_linear_destroy(t);
+}
+
+/**
+ * Return the number of used entries
+ */
+uint32_t hashtable_get_size(hashtable_t *table) {
+    return hashtable_linear_get_size(table);
+}
+
+#else
 /****************************************************************************
  * Private Functions
  ****************************************************************************/
 /**
- * Compute the hash value for the given string.
- * Implements the MurmurHash3 hash function.
- */
-uint64_t hashtable_hash(const char *key) {
-    size_t len = strlen(key);
-    const uint64_t m = 0xc6a4a7935bd1e995ULL;
-    const int r = 47;
-    uint64_t h = 1023724138 ^ (len * m);
-    const uint64_t * data = (const uint64_t *)key;
-    const uint64_t * end = data + (len / 8);
-    while (data != end)
-    {
-        uint64_t k = *data++;
-        k *= m;
-        k ^= k >> r;
-        k *= m;
-        h ^= k;
-        h *= m;
-    }
-    const unsigned char * data2 = (const unsigned char*)data;
-    switch (len & 7) {
-        case 7: h ^= ((uint64_t) data2[6]) << 48;
-        case 6: h ^= ((uint64_t) data2[5]) << 40;
-        case 5: h ^= ((uint64_t) data2[4]) << 32;
-        case 4: h ^= ((uint64_t) data2[3]) << 24;
-        case 3: h ^= ((uint64_t) data2[2]) << 16;
-        case 2: h ^= ((uint64_t) data2[1]) << 8;
-        case 1: h ^= ((uint64_t) data2[0]);
-            h *= m;
-        default:
-            break;
-    };
-    h ^= h >> r;
-    h *= m;
-    h ^= h >> r;
-    return h;
-}
-
-/**
- * Find an available slot for the given key, using linear probing.
- */
-size_t hashtable_find_slot(hashtable_t *table, char *key) {
-    size_t idx = hashtable_hash(key) % table->capacity;
-    while (table->body[idx].key != NULL
-           && strcmp(table->body[idx].key, key) != 0) {
-        idx = (idx + 1) % table->capacity;
+ * Find the slot holding the given key or, if missing, the empty slot where
+ * it would go, using linear probing from the idx slot.
+ */
+static size_t body_find_slot(hashtable_entry_t *body, size_t mask, size_t idx,
+                             const char *key, uint32_t hash, uint32_t len) {
+    hashtable_entry_t *entry;
+    while (HT_ENTRY_USED(entry = &body[idx])
+           && !hashtable_entry_matches(entry, key, hash, len)) {
+        idx = (idx + 1) & mask;
     }
     return idx;
 }
 
+/**
+ * Find the first empty slot along the probe sequence of a hash.
+ */
+static size_t body_find_free_slot(hashtable_entry_t *body, size_t mask, uint32_t hash) {
+    size_t idx = hash & mask;
+    while (HT_ENTRY_USED(&body[idx])) {
+        idx = (idx + 1) & mask;
+    }
+    return idx;
+}
+
+/**
+ * Empty a slot, rearranging the following entries not to disrupt the
+ * probing sequence.
+ */
+static void body_remove_slot(hashtable_entry_t *body, size_t mask, size_t idx) {
+    size_t next = (idx + 1) & mask;
+    while (HT_ENTRY_USED(&body[next])) {
+        size_t next_base = body[next].hash & mask;
+        if ((next > idx && (next_base <= idx || next_base > next))
+            || (next < idx && (next_base <= idx && next_base > next))) {
+            body[idx] = body[next];
+            idx = next;
+        }
+        next = (next + 1) & mask;
+    }
+    hashtable_entry_clear(&body[idx]);
+}
+
 /**
  * Allocate a new memory block with the given capacity.
  */
-static inline hashtable_entry_t *hashtable_body_allocate(unsigned int capacity) {
+static inline hashtable_entry_t *hashtable_body_allocate(uint32_t capacity) {
     return (hashtable_entry_t *) calloc_or_die(capacity, sizeof(hashtable_entry_t));
 }
 
+/**
+ * Home slot of a hash in the old body. Migration empties the old body in
+ * slot order starting from migrate_start, so entries whose home has already
+ * been visited start probing at migrate_pos instead: their run of full slots
+ * from there on is untouched.
+ */
+static inline size_t hashtable_old_home(hashtable_t *t, uint32_t hash) {
+    size_t mask = (size_t) t->old_capacity - 1;
+    size_t home = hash & mask;
+    if (((home - t->migrate_start) & mask) < ((t->migrate_pos - t->migrate_start) & mask))
+        return t->migrate_pos;
+    return home;
+}
+
+/**
+ * Empty a slot of the old body, with the same backward shift as
+ * body_remove_slot() but based on hashtable_old_home().
+ */
+static void hashtable_old_remove_slot(hashtable_t *t, size_t idx) {
+    size_t mask = (size_t) t->old_capacity - 1;
+    hashtable_entry_t *body = t->old_body;
+    size_t next = (idx + 1) & mask;
+    while (HT_ENTRY_USED(&body[next])) {
+        size_t next_base = hashtable_old_home(t, body[next].hash);
+        if (((next - next_base) & mask) >= ((next - idx) & mask)) {
+            body[idx] = body[next];
+            idx = next;
+        }
+        next = (next + 1) & mask;
+    }
+    hashtable_entry_clear(&body[idx]);
+}
+
+/**
+ * Drop the old body once its last entry is gone.
+ */
+static inline void hashtable_old_release(hashtable_t *t) {
+    if (--t->old_size == 0) {
+        free(t->old_body);
+        t->old_body = NULL;
+    }
+}
+
+/**
+ * Move up to the given number of old body slots to the current body.
+ */
+static void hashtable_migrate(hashtable_t *t, unsigned int steps) {
+    size_t mask = (size_t) t->capacity - 1;
+    size_t old_mask = (size_t) t->old_capacity - 1;
+    while (t->old_body != NULL && steps-- > 0) {
+        hashtable_entry_t *entry = &t->old_body[t->migrate_pos];
+        if (HT_ENTRY_USED(entry)) {
+            t->body[body_find_free_slot(t->body, mask, entry->hash)] = *entry;
+            hashtable_entry_clear(entry);
+            hashtable_old_release(t);
+        }
+        t->migrate_pos = (uint32_t) ((t->migrate_pos + 1) & old_mask);
+    }
+}
+
 /****************************************************************************
  * Public Functions
  ****************************************************************************/
@@ -100,6 +344,11 @@ hashtable_t *hashtable_create(void) {
     new_ht->size = 0;
     new_ht->capacity = HT_INITIAL_CAPACITY;
     new_ht->body = hashtable_body_allocate(new_ht->capacity);
+    new_ht->old_body = NULL;
+    new_ht->old_capacity = 0;
+    new_ht->old_size = 0;
+    new_ht->migrate_start = 0;
+    new_ht->migrate_pos = 0;
     return new_ht;
 }
 
@@ -107,89 +356,153 @@ hashtable_t *hashtable_create(void) {
  * Return the item associated with the given key, or NULL if not found.
  */
 void *hashtable_get(hashtable_t *table, char *key) {
-    size_t idx = hashtable_find_slot(table, key);
-    return table->body[idx].key == NULL ? NULL : table->body[idx].value;
+    uint32_t len = HT_KEY_LEN(key);
+    uint32_t hash = HT_KEY_HASH(key, len);
+    size_t idx;
+    hashtable_migrate(table, HT_MIGRATE_STEP);
+    if (table->old_body != NULL) {
+        idx = body_find_slot(table->old_body, (size_t) table->old_capacity - 1,
+                             hashtable_old_home(table, hash), key, hash, len);
+        if (HT_ENTRY_USED(&table->old_body[idx]))
+            return table->old_body[idx].value;
+    }
+    idx = body_find_slot(table->body, (size_t) table->capacity - 1,
+                         hash & (table->capacity - 1), key, hash, len);
+    return !HT_ENTRY_USED(&table->body[idx]) ? NULL : table->body[idx].value;
 }
 
 /**
  * Assign a value to the given key in the table.
  */
 bool hashtable_set(hashtable_t *t, char *key, void *value) {
-    size_t index = hashtable_find_slot(t, key);
-    if (t->body[index].key != NULL) {
+    uint32_t len = HT_KEY_LEN(key);
+    uint32_t hash = HT_KEY_HASH(key, len);
+    hashtable_migrate(t, HT_MIGRATE_STEP);
+    if (t->old_body != NULL) {
+        size_t old_idx = body_find_slot(t->old_body, (size_t) t->old_capacity - 1,
+                                        hashtable_old_home(t, hash), key, hash, len);
+        if (HT_ENTRY_USED(&t->old_body[old_idx]))
+            return false;
+    }
+    size_t index = body_find_slot(t->body, (size_t) t->capacity - 1,
+                                  hash & (t->capacity - 1), key, hash, len);
+    if (HT_ENTRY_USED(&t->body[index])) {
         /* Entry exists; fail. */
         return false;
     } else {
         /* Create a new  entry */
-        if ((float) (t->size + 1) / t->capacity > 0.8) {
+        if ((float) (t->size + 1) / t->capacity > HT_MAX_LOAD) {
             /* Resize the hash table */
-            hashtable_resize(t, t->capacity * (uint16_t)2);
-            index = hashtable_find_slot(t, key);
+            hashtable_resize(t, hashtable_double(t->capacity));
+            index = body_find_free_slot(t->body, (size_t) t->capacity - 1, hash);
         }
-        t->size = t->size + (uint16_t)1;
-        t->body[index].key = key;
-        t->body[index].value = value;
+        t->size++;
+        hashtable_entry_fill(&t->body[index], key, value, hash, len);
         return true;
     }
 }
 
 /**
- * Resize the allocated memory.
- * Warning: clears the table of all entries.
+ * Resize the allocated memory to the given capacity (a power of two).
+ * In incremental mode the old body is only handed over to the following
+ * operations, which migrate it HT_MIGRATE_STEP slots at a time.
  */
-void hashtable_resize(hashtable_t *t, uint16_t capacity) {
-    uint16_t old_capacity = t->capacity;
+void hashtable_resize(hashtable_t *t, uint32_t capacity) {
+    uint32_t old_capacity = t->capacity;
     hashtable_entry_t *old_body = t->body;
+    /* Only one migration at a time */
+    while (t->old_body != NULL)
+        hashtable_migrate(t, old_capacity);
     t->body = hashtable_body_allocate(capacity);
-    t->size = 0;
     t->capacity = capacity;
-    for (unsigned int i = 0; i < old_capacity; i++) {
-        if (old_body[i].key != NULL) {
-            hashtable_set(t, old_body[i].key, old_body[i].value);
-        }
+    if (t->size == 0) {
+        free(old_body);
+        return;
     }
-    free(old_body);
+    t->old_body = old_body;
+    t->old_capacity = old_capacity;
+    t->old_size = t->size;
+    t->migrate_start = 0;
+    while (HT_ENTRY_USED(&old_body[t->migrate_start]))
+        t->migrate_start = (uint32_t) ((t->migrate_start + 1) & (old_capacity - 1));
+    t->migrate_pos = t->migrate_start;
 }
 
 /**
  * Remove a key from the table
  * The algoritm rearranges entries not to disrupt the probing sequence
+ * The table shrinks once it gets sparse.
  */
 void hashtable_remove(hashtable_t *t, char *key) {
-    size_t idx = hashtable_find_slot(t, key);
-    if (t->body[idx].key != NULL) {
-        size_t next = (idx + 1) % t->capacity;
-        while (t->body[next].key != NULL) {
-            size_t next_base = hashtable_hash(t->body[next].key) % t->capacity;
-            if ((next > idx && (next_base <= idx || next_base > next))
-                || (next < idx && (next_base <= idx && next_base > next))) {
-                t->body[idx].key = t->body[next].key;
-                t->body[idx].value = t->body[next].value;
-                idx = next;
-            }
-            next = (next + 1) % t->capacity;
+    uint32_t len = HT_KEY_LEN(key);
+    uint32_t hash = HT_KEY_HASH(key, len);
+    size_t idx;
+    hashtable_migrate(t, HT_MIGRATE_STEP);
+    if (t->old_body != NULL) {
+        idx = body_find_slot(t->old_body, (size_t) t->old_capacity - 1,
+                             hashtable_old_home(t, hash), key, hash, len);
+        if (HT_ENTRY_USED(&t->old_body[idx])) {
+            hashtable_old_remove_slot(t, idx);
+            t->size--;
+            hashtable_old_release(t);
+            return;
         }
-        t->body[idx].key = NULL;
-        t->body[idx].value = NULL;
+    }
+    idx = body_find_slot(t->body, (size_t) t->capacity - 1,
+                         hash & (t->capacity - 1), key, hash, len);
+    if (HT_ENTRY_USED(&t->body[idx])) {
+        body_remove_slot(t->body, (size_t) t->capacity - 1, idx);
         t->size--;
+        /* Never shrink in the middle of a migration */
+        if (t->old_body != NULL)
+            return;
+        if (hashtable_is_sparse(t->size, t->capacity))
+            hashtable_resize(t, t->capacity / 2);
+    }
+}
+
+/**
+ * Shrink the table to the smallest capacity fitting its entries, e.g. after
+ * bulk removals. Any pending migration is completed.
+ */
+void hashtable_compact(hashtable_t *t) {
+    uint32_t capacity = hashtable_fit_capacity(t->size);
+    while (t->old_body != NULL)
+        hashtable_migrate(t, t->old_capacity);
+    if (capacity < t->capacity) {
+        hashtable_resize(t, capacity);
+        while (t->old_body != NULL)
+            hashtable_migrate(t, t->old_capacity);
     }
 }
 
 /**
  * Iterate through table entries (uses only an int as state memory)
  * Return NULL if no other element is present
+ * While a migration is pending, the old body follows the current one.
  */
 void *hashtable_iterate(hashtable_t *table, size_t *state) {
     register size_t local_state = *state;
     while (local_state < table->capacity) {
         hashtable_entry_t *entry;
         entry = &(table->body[local_state]);
-        if (entry->key != NULL) {
+        if (HT_ENTRY_USED(entry)) {
             *state = local_state + 1;
             return entry->value;
         }
         local_state++;
     }
+    if (table->old_body != NULL) {
+        while (local_state < (size_t) table->capacity + table->old_capacity) {
+            hashtable_entry_t *entry;
+            entry = &(table->old_body[local_state - table->capacity]);
+            if (HT_ENTRY_USED(entry)) {
+                *state = local_state + 1;
+                return entry->value;
+            }
+            local_state++;
+        }
+    }
     return NULL;
 }
 
@@ -197,6 +510,7 @@ void *hashtable_iterate(hashtable_t *table, size_t *state) {
  * Destroy the table and deallocate it from memory. This does not deallocate the contained items.
  */
 void hashtable_destroy(hashtable_t *t) {
+    free(t->old_body);
     free(t->body);
     free(t);
 }
@@ -204,6 +518,7 @@ void hashtable_destroy(hashtable_t *t) {
 /**
  * Return the number of used entries
  */
-uint16_t hashtable_get_size(hashtable_t *table) {
+uint32_t hashtable_get_size(hashtable_t *table) {
     return table->size;
 }
+#endif
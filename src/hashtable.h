@@ -22,33 +22,157 @@
  ****************************************************************************/
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+/* Table engines, selected at build time through HT_ENGINE */
+#define HT_ENGINE_LINEAR    0   /* Linear probing */
+#define HT_ENGINE_SWISS     1   /* SIMD group probing over 7-bit hash tags */
+#define HT_ENGINE_ROBINHOOD 2   /* Robin Hood linear probing */
+#define HT_ENGINE_DENSE     3   /* Insertion-ordered entries, sparse index */
+#define HT_ENGINE_CUCKOO    4   /* Bucketized cuckoo hashing, 2 x 4 slots */
+#define HT_ENGINE_CONCURRENT 5  /* Linear probing, lock-free get/iterate */
+
+#ifndef HT_ENGINE
+#define HT_ENGINE HT_ENGINE_LINEAR
+#endif
+
+/* Load factor above which all engines but SWISS grow */
+#ifndef HT_MAX_LOAD
+#define HT_MAX_LOAD 0.8
+#endif
+
+/* Load factor below which removals halve the table */
+#ifndef HT_MIN_LOAD
+#define HT_MIN_LOAD 0.2
+#endif
+
+/* With HT_INCREMENTAL_RESIZE a growing table keeps its old body around,
+ * and every following get/set/remove migrates HT_MIGRATE_STEP of its
+ * slots, so that no single operation pays for the whole rehash. */
+#ifdef HT_INCREMENTAL_RESIZE
+#if HT_ENGINE != HT_ENGINE_LINEAR
+#error "HT_INCREMENTAL_RESIZE is only supported by the linear engine"
+#endif
+#ifndef HT_MIGRATE_STEP
+#define HT_MIGRATE_STEP 8
+#endif
+#endif
+
+/* With HT_STATS the linear engine counts probes, resizes and clusters over
+ * all of its tables, see hashtable_stats.h */
+#if defined(HT_STATS) && (HT_ENGINE != HT_ENGINE_LINEAR || defined(HT_INCREMENTAL_RESIZE))
+#error "HT_STATS is only supported by the linear engine, without HT_INCREMENTAL_RESIZE"
+#endif
+
+/* With HT_KEYLESS entries do not store their key: values must be non-NULL
+ * and hold a pointer to their own key HT_KEY_OFFSET bytes in, like the name
+ * of a node_t. The key passed to hashtable_set() must be that same string. */
+#if defined(HT_KEYLESS) && !defined(HT_KEY_OFFSET)
+#define HT_KEY_OFFSET 0
+#endif
+
+/* With HT_INTERNED_KEYS all keys are interned strings (see intern.h): their
+ * hash and length are read from the intern record, and equal keys are the
+ * same pointer, so their bytes are never hashed nor compared. */
+#ifdef HT_INTERNED_KEYS
+#include "intern.h"
+#endif
+
+/* The CONCURRENT engine serializes writers (set, remove, resize, compact)
+ * on a mutex, while any number of threads get and iterate without locking.
+ * Keys and values are the caller's: they must outlive concurrent readers. */
+#if HT_ENGINE == HT_ENGINE_CONCURRENT
+#include <pthread.h>
+#endif
 
 /****************************************************************************
 * Public Types
 ****************************************************************************/
-/* Hashtable entry */
+#if HT_ENGINE == HT_ENGINE_LINEAR && !defined(HT_INCREMENTAL_RESIZE)
+/* The plain linear engine is an instance of the template: hashtable_linear_t,
+ * hashtable_linear_set() and so on, wrapped by the API below */
+#include <string.h>
+#include "hash.h"
+
+#define HT_T_NAME hashtable_linear
+#define HT_T_KEY char *
+#define HT_T_VALUE void *
+#ifdef HT_INTERNED_KEYS
+#define HT_T_HASH(k) intern_hash(k)
+#define HT_T_EQUAL(a, b) ((a) == (b))
+#else
+#define HT_T_HASH(k) hash_string((k), strlen(k))
+#define HT_T_EQUAL(a, b) ((a) == (b) || strcmp((a), (b)) == 0)
+#endif
+#ifdef HT_KEYLESS
+#define HT_T_KEY_OF(v) (*(char **) ((char *) (v) + HT_KEY_OFFSET))
+#endif
+#define HT_T_MAX_LOAD HT_MAX_LOAD
+#define HT_T_MIN_LOAD HT_MIN_LOAD
+#include "hashtable_template.h"
+
+typedef hashtable_linear_entry_t hashtable_entry_t;
+typedef hashtable_linear_t hashtable_t;
+#else
+/* Hashtable entry, caching the key hash and length */
 typedef struct _hashtable_entry {
+#ifndef HT_KEYLESS
     char                *key;
+#endif
     void                *value;
+    uint32_t            hash;
+#ifndef HT_KEYLESS
+    uint32_t            len;
+#endif
 } hashtable_entry_t;
 
 /* Hashtable */
 typedef struct _hashtable {
-    uint16_t            size;
-    uint16_t            capacity;
-    hashtable_entry_t   *body;
+    uint32_t            size;
+    uint32_t            capacity;
+#if HT_ENGINE == HT_ENGINE_SWISS
+    uint32_t            growth_left;    /* Insertions left before a rehash */
+    uint8_t             *ctrl;          /* One control byte per slot */
+#elif HT_ENGINE == HT_ENGINE_ROBINHOOD
+    uint8_t             *dist;          /* Probe distance + 1 per slot */
+#elif HT_ENGINE == HT_ENGINE_DENSE
+    uint32_t            used;           /* Entries appended, holes included */
+    uint32_t            deleted;        /* Index tombstones, dropped by rebuilds */
+    uint8_t             index_width;    /* Bytes per index slot: 1, 2 or 4 */
+    void                *index;         /* Entry number + 1 per slot */
+#elif HT_ENGINE == HT_ENGINE_CONCURRENT
+    uint32_t            deleted;        /* Tombstones, dropped by rehashes */
+    pthread_mutex_t     lock;           /* Held by writers */
+#endif
+#if HT_ENGINE == HT_ENGINE_CONCURRENT
+    struct _hashtable_body *body;       /* Published to readers */
+#else
+    hashtable_entry_t   *body;          /* Slots, dense entries for DENSE */
+#endif
+#ifdef HT_INCREMENTAL_RESIZE
+    hashtable_entry_t   *old_body;      /* Body being migrated, or NULL */
+    uint32_t            old_capacity;
+    uint32_t            old_size;       /* Entries left in the old body */
+    uint32_t            migrate_start;  /* First old slot migrated */
+    uint32_t            migrate_pos;    /* Next old slot to migrate */
+#endif
 } hashtable_t;
+#endif
 
 /****************************************************************************
  * Public Functions
  ****************************************************************************/
 
-uint16_t hashtable_get_size(hashtable_t *);
+uint32_t hashtable_get_size(hashtable_t *);
 hashtable_t *hashtable_create(void);
 void *hashtable_get(hashtable_t *, char *);
 bool hashtable_set(hashtable_t *, char *, void *);
-void hashtable_resize(hashtable_t *, uint16_t);
+void hashtable_resize(hashtable_t *, uint32_t);
 void hashtable_remove(hashtable_t *, char *);
+void hashtable_compact(hashtable_t *);
 void *hashtable_iterate(hashtable_t *, size_t *);
 void hashtable_destroy(hashtable_t *);
 
@@ -0,0 +1,412 @@
+/*
+ * Copyright 2017 Francesco Circhetta
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * Concurrent linear probing engine.
+ *
+ * Readers never lock: get and iterate run alongside one writer at a time,
+ * writers being serialized by the table mutex.
+ *
+ * Every slot carries a sequence counter, odd while a writer updates it:
+ * readers copy the slot and retry if the counter moved meanwhile, so they
+ * never see half an entry. Entries never move within a body, removals
+ * leave tombstones which are only dropped by a rehash, hence a probe cannot
+ * miss an entry shifted behind its back.
+ *
+ * Rehashes fill a new body and publish it with a single pointer store. The
+ * old body is freed once every reader that could still be inside has left:
+ * readers announce the epoch they enter in their own slot of a registry
+ * shared by all tables, writers bump the epoch after publishing and wait
+ * for the readers of earlier epochs to clear their slot.
+ */
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+#define _POSIX_C_SOURCE 200809L
+
+#include <string.h>
+#include <sched.h>
+#include <pthread.h>
+
+#include "utils.h"
+#include "hash.h"
+#include "hashtable_internal.h"
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+/* Slot states */
+#define HT_SLOT_EMPTY   0
+#define HT_SLOT_USED    1
+#define HT_SLOT_DELETED 2
+
+/* Threads that can read tables at the same time */
+#define HT_MAX_READERS 256
+
+#define HT_CACHE_LINE 64
+
+#define HT_NOT_FOUND ((size_t) -1)
+
+/****************************************************************************
+ * Private Types
+ ****************************************************************************/
+typedef struct _hashtable_slot {
+    uint32_t            seq;            /* Odd while being written */
+    uint32_t            state;
+    hashtable_entry_t   entry;
+} hashtable_slot_t;
+
+struct _hashtable_body {
+    uint32_t            capacity;
+    hashtable_slot_t    slots[];
+};
+
+/* Registry slot of a reader thread, one per cache line */
+typedef union _hashtable_reader {
+    struct {
+        uint64_t        epoch;          /* Epoch entered, 0 when outside */
+        uint32_t        claimed;
+    } r;
+    char                pad[HT_CACHE_LINE];
+} hashtable_reader_t;
+
+/****************************************************************************
+ * Private Data
+ ****************************************************************************/
+static hashtable_reader_t readers[HT_MAX_READERS];
+static uint32_t readers_top;            /* Registry slots ever claimed */
+static uint64_t global_epoch = 1;
+
+static __thread hashtable_reader_t *self;
+static pthread_key_t self_key;
+static pthread_once_t self_key_once = PTHREAD_ONCE_INIT;
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+/**
+ * Give the registry slot of an exiting thread back.
+ */
+static void reader_release(void *reader) {
+    __atomic_store_n(&((hashtable_reader_t *) reader)->r.claimed, 0, __ATOMIC_RELEASE);
+}
+
+static void reader_key_create(void) {
+    if (pthread_key_create(&self_key, reader_release) != 0)
+        exit(-1);
+}
+
+/**
+ * Claim a registry slot for the calling thread. More than HT_MAX_READERS
+ * threads at once crash, like the *_or_die() allocators.
+ */
+static hashtable_reader_t *reader_claim(void) {
+    pthread_once(&self_key_once, reader_key_create);
+    for (uint32_t i = 0; i < HT_MAX_READERS; i++) {
+        uint32_t expected = 0;
+        if (__atomic_compare_exchange_n(&readers[i].r.claimed, &expected, 1, false,
+                                        __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) {
+            uint32_t top = __atomic_load_n(&readers_top, __ATOMIC_SEQ_CST);
+            while (top < i + 1 && !__atomic_compare_exchange_n(&readers_top, &top, i + 1, false,
+                                                               __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST))
+                ;
+            pthread_setspecific(self_key, &readers[i]);
+            return &readers[i];
+        }
+    }
+    exit(-1);
+}
+
+/**
+ * Enter a read section, return the body it may read until it leaves.
+ */
+static struct _hashtable_body *read_enter(hashtable_t *t) {
+    if (self == NULL)
+        self = reader_claim();
+    /* The epoch must be visible before the body is read: writers that swap
+     * the body after this store will wait for us */
+    __atomic_store_n(&self->r.epoch, __atomic_load_n(&global_epoch, __ATOMIC_ACQUIRE),
+                     __ATOMIC_SEQ_CST);
+    return __atomic_load_n(&t->body, __ATOMIC_SEQ_CST);
+}
+
+static void read_leave(void) {
+    __atomic_store_n(&self->r.epoch, 0, __ATOMIC_RELEASE);
+}
+
+/**
+ * Wait until no reader can hold a body unpublished before this call.
+ */
+static void synchronize(void) {
+    uint64_t epoch = __atomic_fetch_add(&global_epoch, 1, __ATOMIC_SEQ_CST);
+    uint32_t top = __atomic_load_n(&readers_top, __ATOMIC_SEQ_CST);
+    for (uint32_t i = 0; i < top; i++) {
+        uint64_t entered;
+        while ((entered = __atomic_load_n(&readers[i].r.epoch, __ATOMIC_SEQ_CST)) != 0
+               && entered <= epoch)
+            sched_yield();
+    }
+}
+
+/**
+ * Copy a slot consistently, return its state. The entry is only filled in
+ * for used slots.
+ */
+static uint32_t slot_read(hashtable_slot_t *slot, hashtable_entry_t *entry) {
+    for (;;) {
+        uint32_t seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+        if (seq & 1)
+            continue;
+        /* Acquire loads keep the second counter load after them: if any of
+         * them saw a new value, the counter has moved too */
+        uint32_t state = __atomic_load_n(&slot->state, __ATOMIC_ACQUIRE);
+        if (state == HT_SLOT_USED) {
+#ifndef HT_KEYLESS
+            entry->key = __atomic_load_n(&slot->entry.key, __ATOMIC_ACQUIRE);
+            entry->len = __atomic_load_n(&slot->entry.len, __ATOMIC_ACQUIRE);
+#endif
+            entry->value = __atomic_load_n(&slot->entry.value, __ATOMIC_ACQUIRE);
+            entry->hash = __atomic_load_n(&slot->entry.hash, __ATOMIC_ACQUIRE);
+        }
+        if (__atomic_load_n(&slot->seq, __ATOMIC_RELAXED) == seq)
+            return state;
+    }
+}
+
+/**
+ * Update a slot of a published body, under the writer lock. Release stores
+ * make a reader seeing any of the new fields see the odd counter too.
+ */
+static void slot_write(hashtable_slot_t *slot, uint32_t state, const hashtable_entry_t *entry) {
+    uint32_t seq = slot->seq;
+    __atomic_store_n(&slot->seq, seq + 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&slot->state, state, __ATOMIC_RELEASE);
+    if (entry != NULL) {
+#ifndef HT_KEYLESS
+        __atomic_store_n(&slot->entry.key, entry->key, __ATOMIC_RELEASE);
+        __atomic_store_n(&slot->entry.len, entry->len, __ATOMIC_RELEASE);
+#endif
+        __atomic_store_n(&slot->entry.value, entry->value, __ATOMIC_RELEASE);
+        __atomic_store_n(&slot->entry.hash, entry->hash, __ATOMIC_RELEASE);
+    }
+    __atomic_store_n(&slot->seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+static struct _hashtable_body *body_create(uint32_t capacity) {
+    struct _hashtable_body *body =
+            calloc_or_die(1, sizeof(struct _hashtable_body) + capacity * sizeof(hashtable_slot_t));
+    body->capacity = capacity;
+    return body;
+}
+
+/**
+ * Find the slot holding the given key, or HT_NOT_FOUND. Writers only: they
+ * read the current body without copying slots.
+ */
+static size_t find_slot(struct _hashtable_body *body, const char *key, uint32_t hash, uint32_t len) {
+    size_t mask = (size_t) body->capacity - 1;
+    for (size_t idx = hash & mask; body->slots[idx].state != HT_SLOT_EMPTY; idx = (idx + 1) & mask) {
+        hashtable_slot_t *slot = &body->slots[idx];
+        if (slot->state == HT_SLOT_USED && hashtable_entry_matches(&slot->entry, key, hash, len))
+            return idx;
+    }
+    return HT_NOT_FOUND;
+}
+
+/**
+ * First slot an entry with the given hash can take, tombstones included.
+ */
+static size_t free_slot(struct _hashtable_body *body, uint32_t hash) {
+    size_t mask = (size_t) body->capacity - 1;
+    size_t idx = hash & mask;
+    while (body->slots[idx].state == HT_SLOT_USED)
+        idx = (idx + 1) & mask;
+    return idx;
+}
+
+/**
+ * Move the entries to a new body of the given capacity, dropping the
+ * tombstones, then free the old body once readers are done with it.
+ */
+static void rehash(hashtable_t *t, uint32_t capacity) {
+    struct _hashtable_body *old_body = t->body;
+    struct _hashtable_body *body = body_create(capacity);
+    for (uint32_t i = 0; i < old_body->capacity; i++) {
+        hashtable_slot_t *slot = &old_body->slots[i];
+        if (slot->state == HT_SLOT_USED) {
+            hashtable_slot_t *dest = &body->slots[free_slot(body, slot->entry.hash)];
+            dest->state = HT_SLOT_USED;
+            dest->entry = slot->entry;
+        }
+    }
+    __atomic_store_n(&t->body, body, __ATOMIC_SEQ_CST);
+    t->capacity = capacity;
+    t->deleted = 0;
+    synchronize();
+    free(old_body);
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+/**
+ * Create a new, empty hashtable
+ */
+hashtable_t *hashtable_create(void) {
+    hashtable_t *new_ht = malloc_or_die(sizeof(hashtable_t));
+    new_ht->size = 0;
+    new_ht->capacity = HT_INITIAL_CAPACITY;
+    new_ht->deleted = 0;
+    if (pthread_mutex_init(&new_ht->lock, NULL) != 0)
+        exit(-1);
+    new_ht->body = body_create(new_ht->capacity);
+    return new_ht;
+}
+
+/**
+ * Return the item associated with the given key, or NULL if not found.
+ * Lock-free, safe against concurrent writers.
+ */
+void *hashtable_get(hashtable_t *table, char *key) {
+    hashtable_entry_t entry;
+    void *value = NULL;
+    uint32_t len = HT_KEY_LEN(key);
+    uint32_t hash = HT_KEY_HASH(key, len);
+    struct _hashtable_body *body = read_enter(table);
+    size_t mask = (size_t) body->capacity - 1;
+    for (size_t idx = hash & mask;; idx = (idx + 1) & mask) {
+        uint32_t state = slot_read(&body->slots[idx], &entry);
+        if (state == HT_SLOT_EMPTY)
+            break;
+        if (state == HT_SLOT_USED && hashtable_entry_matches(&entry, key, hash, len)) {
+            value = entry.value;
+            break;
+        }
+    }
+    read_leave();
+    return value;
+}
+
+/**
+ * Assign a value to the given key in the table.
+ */
+bool hashtable_set(hashtable_t *t, char *key, void *value) {
+    hashtable_entry_t entry;
+    uint32_t len = HT_KEY_LEN(key);
+    uint32_t hash = HT_KEY_HASH(key, len);
+    pthread_mutex_lock(&t->lock);
+    if (find_slot(t->body, key, hash, len) != HT_NOT_FOUND) {
+        /* Entry exists; fail. */
+        pthread_mutex_unlock(&t->lock);
+        return false;
+    }
+    if ((float) (t->size + t->deleted + 1) / t->capacity > HT_MAX_LOAD) {
+        /* Grow, or only drop the tombstones if they make most of the load */
+        if ((float) (t->size + 1) / t->capacity > HT_MAX_LOAD / 2)
+            rehash(t, hashtable_double(t->capacity));
+        else
+            rehash(t, t->capacity);
+    }
+    hashtable_slot_t *slot = &t->body->slots[free_slot(t->body, hash)];
+    if (slot->state == HT_SLOT_DELETED)
+        t->deleted--;
+    hashtable_entry_fill(&entry, key, value, hash, len);
+    slot_write(slot, HT_SLOT_USED, &entry);
+    __atomic_store_n(&t->size, t->size + 1, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&t->lock);
+    return true;
+}
+
+/**
+ * Resize the allocated memory to the given capacity (a power of two).
+ */
+void hashtable_resize(hashtable_t *t, uint32_t capacity) {
+    pthread_mutex_lock(&t->lock);
+    rehash(t, capacity);
+    pthread_mutex_unlock(&t->lock);
+}
+
+/**
+ * Remove a key from the table
+ * Its slot becomes a tombstone, so that concurrent probes go on past it.
+ * The table shrinks once it gets sparse.
+ */
+void hashtable_remove(hashtable_t *t, char *key) {
+    uint32_t len = HT_KEY_LEN(key);
+    uint32_t hash = HT_KEY_HASH(key, len);
+    pthread_mutex_lock(&t->lock);
+    size_t idx = find_slot(t->body, key, hash, len);
+    if (idx != HT_NOT_FOUND) {
+        slot_write(&t->body->slots[idx], HT_SLOT_DELETED, NULL);
+        __atomic_store_n(&t->size, t->size - 1, __ATOMIC_RELAXED);
+        t->deleted++;
+        if (hashtable_is_sparse(t->size, t->capacity))
+            rehash(t, t->capacity / 2);
+    }
+    pthread_mutex_unlock(&t->lock);
+}
+
+/**
+ * Shrink the table to the smallest capacity fitting its entries, e.g. after
+ * bulk removals.
+ */
+void hashtable_compact(hashtable_t *t) {
+    pthread_mutex_lock(&t->lock);
+    uint32_t capacity = hashtable_fit_capacity(t->size);
+    if (capacity < t->capacity)
+        rehash(t, capacity);
+    pthread_mutex_unlock(&t->lock);
+}
+
+/**
+ * Iterate through table entries (uses only an int as state memory)
+ * Return NULL if no other element is present
+ * Lock-free. Entries set or removed meanwhile may or may not be returned,
+ * and a concurrent rehash may make the iteration skip or repeat entries.
+ */
+void *hashtable_iterate(hashtable_t *table, size_t *state) {
+    hashtable_entry_t entry;
+    void *value = NULL;
+    struct _hashtable_body *body = read_enter(table);
+    for (size_t idx = *state; idx < body->capacity; idx++) {
+        if (slot_read(&body->slots[idx], &entry) == HT_SLOT_USED) {
+            *state = idx + 1;
+            value = entry.value;
+            break;
+        }
+    }
+    read_leave();
+    return value;
+}
+
+/**
+ * Destroy the table and deallocate it from memory. This does not deallocate the contained items.
+ * No other thread may use the table anymore.
+ */
+void hashtable_destroy(hashtable_t *t) {
+    pthread_mutex_destroy(&t->lock);
+    free(t->body);
+    free(t);
+}
+
+/**
+ * Return the number of used entries
+ */
+uint32_t hashtable_get_size(hashtable_t *table) {
+    return __atomic_load_n(&table->size, __ATOMIC_RELAXED);
+}
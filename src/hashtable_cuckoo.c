@@ -0,0 +1,263 @@
+/*
+ * Copyright 2017 Francesco Circhetta
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * Bucketized cuckoo hashing engine.
+ *
+ * Slots are grouped in buckets of HT_BUCKET_SLOTS, and every key may only
+ * live in one of two buckets: the one picked by its hash, and an alternate
+ * one found by xoring in a mix of the same hash. Either bucket can compute
+ * the other from the cached hash alone, so entries move without reading
+ * their key. Lookups inspect at most two buckets however keys cluster;
+ * insertions into two full buckets evict a resident to its other bucket,
+ * and so on, growing the table if the chain gets too long.
+ *
+ * Bodies are aligned to HT_CACHE_LINE. Key-less, a bucket is 4 x 16 bytes,
+ * exactly one line, so a lookup touches at most two cache lines. Keyed
+ * entries are 24 bytes: a bucket spans two lines, and a lookup up to four.
+ */
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+#define _POSIX_C_SOURCE 200112L /* posix_memalign() */
+#include <string.h>
+
+#include "utils.h"
+#include "hash.h"
+#include "hashtable_internal.h"
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+#define HT_BUCKET_SLOTS 4
+#define HT_CACHE_LINE 64
+
+/* Evictions tried before an insertion gives up and grows the table */
+#define HT_MAX_KICKS 128
+
+#define HT_NOT_FOUND ((size_t) -1)
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+static inline size_t bucket_mask(const hashtable_t *t) {
+    return (size_t) t->capacity / HT_BUCKET_SLOTS - 1;
+}
+
+/**
+ * Allocate an empty body of the given capacity, aligned to a cache line
+ */
+static hashtable_entry_t *body_allocate(uint32_t capacity) {
+    void *body;
+    size_t bytes = (size_t) capacity * sizeof(hashtable_entry_t);
+    if (posix_memalign(&body, HT_CACHE_LINE, bytes) != 0)
+        exit(-1);
+    return memset(body, 0, bytes);
+}
+
+/**
+ * First bucket of a hash.
+ */
+static inline size_t bucket_first(const hashtable_t *t, uint32_t hash) {
+    return hash & bucket_mask(t);
+}
+
+/**
+ * The other bucket of a hash, from either of them. The offset is odd, so
+ * the two buckets are always distinct.
+ */
+static inline size_t bucket_other(const hashtable_t *t, size_t bucket, uint32_t hash) {
+    uint32_t offset = hash * 0x5bd1e995U;
+    offset ^= offset >> 15;
+    return (bucket ^ (offset | 1)) & bucket_mask(t);
+}
+
+/**
+ * Find the slot holding the given key, or HT_NOT_FOUND.
+ */
+static size_t hashtable_find_slot(hashtable_t *t, const char *key,
+                                  uint32_t hash, uint32_t len) {
+    size_t bucket = bucket_first(t, hash);
+    for (unsigned int b = 0; b < 2; b++) {
+        hashtable_entry_t *slots = &t->body[bucket * HT_BUCKET_SLOTS];
+        for (unsigned int i = 0; i < HT_BUCKET_SLOTS; i++) {
+            if (HT_ENTRY_USED(&slots[i]) && hashtable_entry_matches(&slots[i], key, hash, len))
+                return bucket * HT_BUCKET_SLOTS + i;
+        }
+        bucket = bucket_other(t, bucket, hash);
+    }
+    return HT_NOT_FOUND;
+}
+
+/**
+ * Place an entry in a free slot of a bucket, if any.
+ */
+static inline bool bucket_insert(hashtable_t *t, size_t bucket, hashtable_entry_t *entry) {
+    hashtable_entry_t *slots = &t->body[bucket * HT_BUCKET_SLOTS];
+    for (unsigned int i = 0; i < HT_BUCKET_SLOTS; i++) {
+        if (!HT_ENTRY_USED(&slots[i])) {
+            slots[i] = *entry;
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Place an entry known to be missing from the table, evicting residents to
+ * their other bucket when both of its buckets are full. The table grows if
+ * no free slot shows up within HT_MAX_KICKS evictions.
+ */
+static void hashtable_insert(hashtable_t *t, hashtable_entry_t entry) {
+    size_t bucket = bucket_first(t, entry.hash);
+    if (bucket_insert(t, bucket, &entry))
+        return;
+    bucket = bucket_other(t, bucket, entry.hash);
+    for (unsigned int kick = 0; kick < HT_MAX_KICKS; kick++) {
+        if (bucket_insert(t, bucket, &entry))
+            return;
+        /* Vary the victim, so that evictions do not cycle between two slots */
+        hashtable_entry_t *victim = &t->body[bucket * HT_BUCKET_SLOTS
+                                             + (kick + entry.hash) % HT_BUCKET_SLOTS];
+        hashtable_entry_t tmp_entry = *victim;
+        *victim = entry;
+        entry = tmp_entry;
+        bucket = bucket_other(t, bucket, entry.hash);
+    }
+    /* The evictions likely cycle: grow, which spreads the buckets, then
+     * place the entry evicted last */
+    hashtable_resize(t, hashtable_double(t->capacity));
+    hashtable_insert(t, entry);
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+/**
+ * Create a new, empty hashtable
+ */
+hashtable_t *hashtable_create(void) {
+    hashtable_t *new_ht = malloc_or_die(sizeof(hashtable_t));
+    new_ht->size = 0;
+    new_ht->capacity = HT_INITIAL_CAPACITY;
+    new_ht->body = body_allocate(new_ht->capacity);
+    return new_ht;
+}
+
+/**
+ * Return the item associated with the given key, or NULL if not found.
+ */
+void *hashtable_get(hashtable_t *table, char *key) {
+    uint32_t len = HT_KEY_LEN(key);
+    size_t idx = hashtable_find_slot(table, key, HT_KEY_HASH(key, len), len);
+    return idx == HT_NOT_FOUND ? NULL : table->body[idx].value;
+}
+
+/**
+ * Assign a value to the given key in the table.
+ */
+bool hashtable_set(hashtable_t *t, char *key, void *value) {
+    hashtable_entry_t entry;
+    uint32_t len = HT_KEY_LEN(key);
+    uint32_t hash = HT_KEY_HASH(key, len);
+    if (hashtable_find_slot(t, key, hash, len) != HT_NOT_FOUND) {
+        /* Entry exists; fail. */
+        return false;
+    }
+    if ((float) (t->size + 1) / t->capacity > HT_MAX_LOAD) {
+        /* Resize the hash table */
+        hashtable_resize(t, hashtable_double(t->capacity));
+    }
+    hashtable_entry_fill(&entry, key, value, hash, len);
+    hashtable_insert(t, entry);
+    t->size++;
+    return true;
+}
+
+/**
+ * Resize the allocated memory to the given capacity (a power of two, at
+ * least HT_BUCKET_SLOTS * 2).
+ */
+void hashtable_resize(hashtable_t *t, uint32_t capacity) {
+    uint32_t old_capacity = t->capacity;
+    hashtable_entry_t *old_body = t->body;
+    t->capacity = capacity;
+    t->body = body_allocate(capacity);
+    for (unsigned int i = 0; i < old_capacity; i++) {
+        if (HT_ENTRY_USED(&old_body[i])) {
+            hashtable_insert(t, old_body[i]);
+        }
+    }
+    free(old_body);
+}
+
+/**
+ * Remove a key from the table
+ * Nothing else moves. The table shrinks once it gets sparse.
+ */
+void hashtable_remove(hashtable_t *t, char *key) {
+    uint32_t len = HT_KEY_LEN(key);
+    size_t idx = hashtable_find_slot(t, key, HT_KEY_HASH(key, len), len);
+    if (idx != HT_NOT_FOUND) {
+        hashtable_entry_clear(&t->body[idx]);
+        t->size--;
+        if (hashtable_is_sparse(t->size, t->capacity))
+            hashtable_resize(t, t->capacity / 2);
+    }
+}
+
+/**
+ * Shrink the table to the smallest capacity fitting its entries, e.g. after
+ * bulk removals.
+ */
+void hashtable_compact(hashtable_t *t) {
+    uint32_t capacity = hashtable_fit_capacity(t->size);
+    if (capacity < t->capacity)
+        hashtable_resize(t, capacity);
+}
+
+/**
+ * Iterate through table entries (uses only an int as state memory)
+ * Return NULL if no other element is present
+ */
+void *hashtable_iterate(hashtable_t *table, size_t *state) {
+    register size_t local_state = *state;
+    while (local_state < table->capacity) {
+        if (HT_ENTRY_USED(&table->body[local_state])) {
+            *state = local_state + 1;
+            return table->body[local_state].value;
+        }
+        local_state++;
+    }
+    return NULL;
+}
+
+/**
+ * Destroy the table and deallocate it from memory. This does not deallocate the contained items.
+ */
+void hashtable_destroy(hashtable_t *t) {
+    free(t->body);
+    free(t);
+}
+
+/**
+ * Return the number of used entries
+ */
+uint32_t hashtable_get_size(hashtable_t *table) {
+    return table->size;
+}
@@ -0,0 +1,254 @@
+/*
+ * Copyright 2017 Francesco Circhetta
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * Dense engine, in the style of compact dicts.
+ *
+ * Entries are appended to a dense array in insertion order, and a separate
+ * open addressing index, probed linearly, maps hashes to entry numbers.
+ * Index slots take 1, 2 or 4 bytes depending on how many entries the table
+ * can hold, so the probed memory stays small. Removed entries leave a hole
+ * in the array, reclaimed at the next rebuild, and a tombstone in the index.
+ * Iteration walks the dense array only.
+ */
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+#include <string.h>
+
+#include "utils.h"
+#include "hash.h"
+#include "hashtable_internal.h"
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+/* Index slot values, others are entry numbers + 1 */
+#define HT_INDEX_EMPTY 0
+#define HT_INDEX_DELETED(width) ((uint32_t) (((uint64_t) 1 << (8 * (width))) - 1))
+
+#define HT_NOT_FOUND ((size_t) -1)
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+/**
+ * Number of entries a table with the given index capacity can hold.
+ */
+static inline uint32_t hashtable_usable(uint32_t capacity) {
+    return (uint32_t) (capacity * HT_MAX_LOAD);
+}
+
+static inline uint32_t index_get(const hashtable_t *t, size_t i) {
+    switch (t->index_width) {
+        case 1: return ((const uint8_t *) t->index)[i];
+        case 2: return ((const uint16_t *) t->index)[i];
+        default: return ((const uint32_t *) t->index)[i];
+    }
+}
+
+static inline void index_set(hashtable_t *t, size_t i, uint32_t value) {
+    switch (t->index_width) {
+        case 1: ((uint8_t *) t->index)[i] = (uint8_t) value; break;
+        case 2: ((uint16_t *) t->index)[i] = (uint16_t) value; break;
+        default: ((uint32_t *) t->index)[i] = value; break;
+    }
+}
+
+/**
+ * Find the index slot pointing to the given key, or HT_NOT_FOUND.
+ */
+static size_t hashtable_find_slot(hashtable_t *t, const char *key,
+                                  uint32_t hash, uint32_t len) {
+    size_t mask = (size_t) t->capacity - 1;
+    uint32_t deleted = HT_INDEX_DELETED(t->index_width);
+    for (size_t idx = hash & mask;; idx = (idx + 1) & mask) {
+        uint32_t ix = index_get(t, idx);
+        if (ix == HT_INDEX_EMPTY)
+            return HT_NOT_FOUND;
+        if (ix != deleted) {
+            hashtable_entry_t *entry = &t->body[ix - 1];
+            if (hashtable_entry_matches(entry, key, hash, len))
+                return idx;
+        }
+    }
+}
+
+/**
+ * Point the first free index slot along the probe sequence of the given
+ * hash to an entry.
+ */
+static void hashtable_index_insert(hashtable_t *t, uint32_t hash, uint32_t ix) {
+    size_t mask = (size_t) t->capacity - 1;
+    uint32_t deleted = HT_INDEX_DELETED(t->index_width);
+    size_t idx = hash & mask;
+    uint32_t v;
+    for (v = index_get(t, idx); v != HT_INDEX_EMPTY && v != deleted; v = index_get(t, idx))
+        idx = (idx + 1) & mask;
+    if (v == deleted)
+        t->deleted--;
+    index_set(t, idx, ix + 1);
+}
+
+/**
+ * Allocate an empty index and entry array with the given capacity.
+ */
+static void hashtable_body_allocate(hashtable_t *t, uint32_t capacity) {
+    uint32_t usable = hashtable_usable(capacity);
+    t->capacity = capacity;
+    t->used = 0;
+    t->deleted = 0;
+    /* The deleted value must not be a valid entry number + 1 */
+    t->index_width = (uint8_t) (usable < UINT8_MAX ? 1 : usable < UINT16_MAX ? 2 : 4);
+    t->index = calloc_or_die(capacity, t->index_width);
+    t->body = malloc_or_die(usable * sizeof(hashtable_entry_t));
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+/**
+ * Create a new, empty hashtable
+ */
+hashtable_t *hashtable_create(void) {
+    hashtable_t *new_ht = malloc_or_die(sizeof(hashtable_t));
+    new_ht->size = 0;
+    hashtable_body_allocate(new_ht, HT_INITIAL_CAPACITY);
+    return new_ht;
+}
+
+/**
+ * Return the item associated with the given key, or NULL if not found.
+ */
+void *hashtable_get(hashtable_t *table, char *key) {
+    uint32_t len = HT_KEY_LEN(key);
+    size_t idx = hashtable_find_slot(table, key, HT_KEY_HASH(key, len), len);
+    return idx == HT_NOT_FOUND ? NULL : table->body[index_get(table, idx) - 1].value;
+}
+
+/**
+ * Assign a value to the given key in the table.
+ */
+bool hashtable_set(hashtable_t *t, char *key, void *value) {
+    uint32_t len = HT_KEY_LEN(key);
+    uint32_t hash = HT_KEY_HASH(key, len);
+    if (hashtable_find_slot(t, key, hash, len) != HT_NOT_FOUND) {
+        /* Entry exists; fail. */
+        return false;
+    }
+    /* The index must keep empty slots for probes to stop: tombstones count
+     * as taken, and trailing holes are popped without giving theirs back */
+    if (t->used == hashtable_usable(t->capacity)
+        || t->size + t->deleted >= hashtable_usable(t->capacity)) {
+        /* Grow if the table is really full, otherwise just drop holes and
+         * tombstones */
+        if (t->size + 1 > hashtable_usable(t->capacity) / 2)
+            hashtable_resize(t, hashtable_double(t->capacity));
+        else
+            hashtable_resize(t, t->capacity);
+    }
+    hashtable_entry_fill(&t->body[t->used], key, value, hash, len);
+    hashtable_index_insert(t, hash, t->used);
+    t->used++;
+    t->size++;
+    return true;
+}
+
+/**
+ * Rebuild the table with the given capacity (a power of two), compacting
+ * the entries in their insertion order and dropping tombstones.
+ */
+void hashtable_resize(hashtable_t *t, uint32_t capacity) {
+    uint32_t old_used = t->used;
+    void *old_index = t->index;
+    hashtable_entry_t *old_body = t->body;
+    hashtable_body_allocate(t, capacity);
+    for (unsigned int i = 0; i < old_used; i++) {
+        if (HT_ENTRY_USED(&old_body[i])) {
+            t->body[t->used] = old_body[i];
+            hashtable_index_insert(t, old_body[i].hash, t->used);
+            t->used++;
+        }
+    }
+    free(old_index);
+    free(old_body);
+}
+
+/**
+ * Remove a key from the table
+ * The entry becomes a hole, or is dropped if it was the last one, and its
+ * index slot a tombstone. The table shrinks once it gets sparse.
+ */
+void hashtable_remove(hashtable_t *t, char *key) {
+    uint32_t len = HT_KEY_LEN(key);
+    size_t idx = hashtable_find_slot(t, key, HT_KEY_HASH(key, len), len);
+    if (idx != HT_NOT_FOUND) {
+        hashtable_entry_clear(&t->body[index_get(t, idx) - 1]);
+        index_set(t, idx, HT_INDEX_DELETED(t->index_width));
+        t->deleted++;
+        while (t->used > 0 && !HT_ENTRY_USED(&t->body[t->used - 1]))
+            t->used--;
+        t->size--;
+        if (hashtable_is_sparse(t->size, t->capacity))
+            hashtable_resize(t, t->capacity / 2);
+    }
+}
+
+/**
+ * Rebuild the table with the smallest capacity fitting its entries, e.g.
+ * after bulk removals. Holes and tombstones are dropped even if the
+ * capacity stays.
+ */
+void hashtable_compact(hashtable_t *t) {
+    uint32_t capacity = hashtable_fit_capacity(t->size);
+    if (capacity < t->capacity || t->used > t->size)
+        hashtable_resize(t, capacity < t->capacity ? capacity : t->capacity);
+}
+
+/**
+ * Iterate through table entries in insertion order (uses only an int as
+ * state memory)
+ * Return NULL if no other element is present
+ */
+void *hashtable_iterate(hashtable_t *table, size_t *state) {
+    register size_t local_state = *state;
+    while (local_state < table->used) {
+        if (HT_ENTRY_USED(&table->body[local_state])) {
+            *state = local_state + 1;
+            return table->body[local_state].value;
+        }
+        local_state++;
+    }
+    return NULL;
+}
+
+/**
+ * Destroy the table and deallocate it from memory. This does not deallocate the contained items.
+ */
+void hashtable_destroy(hashtable_t *t) {
+    free(t->index);
+    free(t->body);
+    free(t);
+}
+
+/**
+ * Return the number of used entries
+ */
+uint32_t hashtable_get_size(hashtable_t *table) {
+    return table->size;
+}
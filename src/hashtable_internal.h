@@ -0,0 +1,128 @@
+/*
+ * Copyright 2017 Francesco Circhetta
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef API_HASHTABLE_INTERNAL_H
+#define API_HASHTABLE_INTERNAL_H
+
+/**
+ * Definitions shared by the hashtable engines, not part of the public API.
+ */
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+#include <stdlib.h>
+#include <string.h>
+
+#include "hashtable.h"
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+#define HT_INITIAL_CAPACITY 32
+
+/* Key of an entry, and whether the entry is in use. Entries cache the
+ * hash of their key: engines resize, rehash and index them from it alone,
+ * and only read a key to tell it from another of the same hash. */
+#ifdef HT_KEYLESS
+#define HT_ENTRY_KEY(entry) (*(char **) ((char *) (entry)->value + HT_KEY_OFFSET))
+#define HT_ENTRY_USED(entry) ((entry)->value != NULL)
+#else
+#define HT_ENTRY_KEY(entry) ((entry)->key)
+#define HT_ENTRY_USED(entry) ((entry)->key != NULL)
+#endif
+
+/* Length and hash of a key */
+#ifdef HT_INTERNED_KEYS
+#define HT_KEY_LEN(key) ((uint32_t) intern_len(key))
+#define HT_KEY_HASH(key, len) ((uint32_t) intern_hash(key))
+#else
+#define HT_KEY_LEN(key) ((uint32_t) strlen(key))
+#define HT_KEY_HASH(key, len) ((uint32_t) hash_string((key), (len)))
+#endif
+
+/****************************************************************************
+ * Inline Functions
+ ****************************************************************************/
+/**
+ * Whether an entry holds the given key. Cached hashes (and lengths) filter
+ * out mismatching entries without touching their key bytes.
+ */
+static inline bool hashtable_entry_matches(const hashtable_entry_t *entry, const char *key,
+                                           uint32_t hash, uint32_t len) {
+#if defined(HT_INTERNED_KEYS)
+    (void) len;
+    return entry->hash == hash && HT_ENTRY_KEY(entry) == key;
+#elif defined(HT_KEYLESS)
+    (void) len;
+    /* Interned keys are the very same string */
+    return entry->hash == hash && (HT_ENTRY_KEY(entry) == key || strcmp(HT_ENTRY_KEY(entry), key) == 0);
+#else
+    return entry->hash == hash && entry->len == len && memcmp(entry->key, key, len) == 0;
+#endif
+}
+
+static inline void hashtable_entry_fill(hashtable_entry_t *entry, char *key, void *value,
+                                        uint32_t hash, uint32_t len) {
+#ifdef HT_KEYLESS
+    (void) key;
+    (void) len;
+#else
+    entry->key = key;
+    entry->len = len;
+#endif
+    entry->value = value;
+    entry->hash = hash;
+}
+
+static inline void hashtable_entry_clear(hashtable_entry_t *entry) {
+#ifndef HT_KEYLESS
+    entry->key = NULL;
+#endif
+    entry->value = NULL;
+}
+
+/**
+ * Smallest capacity holding the given number of entries at half the maximum
+ * load, which is the load of a table right after it grows.
+ */
+static inline uint32_t hashtable_fit_capacity(uint32_t size) {
+    uint32_t capacity = HT_INITIAL_CAPACITY;
+    while (size > capacity * HT_MAX_LOAD / 2 && capacity <= UINT32_MAX / 2)
+        capacity *= 2;
+    return capacity;
+}
+
+/**
+ * Twice the given capacity. Growing past the largest capacity crashes, like
+ * the *_or_die() allocators, instead of wrapping around (this also ends
+ * Robin Hood floods of keys sharing every hash bit the table can use).
+ */
+static inline uint32_t hashtable_double(uint32_t capacity) {
+    if (capacity > UINT32_MAX / 2)
+        exit(-1);
+    return capacity * 2;
+}
+
+/**
+ * Whether a table shrunk by one entry should halve its capacity. Growing at
+ * HT_MAX_LOAD and halving below HT_MIN_LOAD leaves room for hysteresis.
+ */
+static inline bool hashtable_is_sparse(uint32_t size, uint32_t capacity) {
+    return capacity > HT_INITIAL_CAPACITY && (float) size / capacity < HT_MIN_LOAD;
+}
+
+#endif //API_HASHTABLE_INTERNAL_H
@@ -0,0 +1,226 @@
+/*
+ * Copyright 2017 Francesco Circhetta
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * Robin Hood hashing engine.
+ *
+ * Linear probing where an insertion takes the slot of any resident that is
+ * closer to its home than the new entry is, so probe distances stay even.
+ * Every slot records its probe distance in a separate byte array (0 means
+ * empty, d + 1 means distance d): lookups stop as soon as they would be
+ * farther from home than the resident, and removals shift the following
+ * entries back by one until one is already home.
+ */
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+#include <string.h>
+
+#include "utils.h"
+#include "hash.h"
+#include "hashtable_internal.h"
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+/* Largest probe distance a slot can record; reaching it grows the table */
+#define HT_MAX_DIST 254
+
+#define HT_NOT_FOUND ((size_t) -1)
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+/**
+ * Find the slot holding the given key, or HT_NOT_FOUND.
+ */
+static size_t hashtable_find_slot(hashtable_t *t, const char *key,
+                                  uint32_t hash, uint32_t len) {
+    size_t mask = (size_t) t->capacity - 1;
+    size_t idx = hash & mask;
+    /* Like the dist bytes, d is the probe distance + 1 */
+    for (unsigned int d = 1; t->dist[idx] >= d; d++) {
+        hashtable_entry_t *entry = &t->body[idx];
+        if (hashtable_entry_matches(entry, key, hash, len))
+            return idx;
+        idx = (idx + 1) & mask;
+    }
+    return HT_NOT_FOUND;
+}
+
+/**
+ * Place an entry known to be missing from the table, displacing residents
+ * closer to their home. The table grows if a probe distance would overflow.
+ */
+static void hashtable_insert(hashtable_t *t, hashtable_entry_t entry) {
+    size_t mask = (size_t) t->capacity - 1;
+    size_t idx = entry.hash & mask;
+    unsigned int d = 1;
+    while (t->dist[idx] != 0) {
+        if (t->dist[idx] < d) {
+            /* The resident is richer: take its slot and carry it on */
+            hashtable_entry_t tmp_entry = t->body[idx];
+            unsigned int tmp_d = t->dist[idx];
+            t->body[idx] = entry;
+            t->dist[idx] = (uint8_t) d;
+            entry = tmp_entry;
+            d = tmp_d;
+        }
+        idx = (idx + 1) & mask;
+        if (++d > HT_MAX_DIST) {
+            /* Too far from home for a byte of distance: grow, then place
+             * the entry carried so far */
+            hashtable_resize(t, hashtable_double(t->capacity));
+            hashtable_insert(t, entry);
+            return;
+        }
+    }
+    t->body[idx] = entry;
+    t->dist[idx] = (uint8_t) d;
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+/**
+ * Create a new, empty hashtable
+ */
+hashtable_t *hashtable_create(void) {
+    hashtable_t *new_ht = malloc_or_die(sizeof(hashtable_t));
+    new_ht->size = 0;
+    new_ht->capacity = HT_INITIAL_CAPACITY;
+    new_ht->dist = calloc_or_die(new_ht->capacity, sizeof(uint8_t));
+    new_ht->body = calloc_or_die(new_ht->capacity, sizeof(hashtable_entry_t));
+    return new_ht;
+}
+
+/**
+ * Return the item associated with the given key, or NULL if not found.
+ */
+void *hashtable_get(hashtable_t *table, char *key) {
+    uint32_t len = HT_KEY_LEN(key);
+    size_t idx = hashtable_find_slot(table, key, HT_KEY_HASH(key, len), len);
+    return idx == HT_NOT_FOUND ? NULL : table->body[idx].value;
+}
+
+/**
+ * Assign a value to the given key in the table.
+ */
+bool hashtable_set(hashtable_t *t, char *key, void *value) {
+    hashtable_entry_t entry;
+    uint32_t len = HT_KEY_LEN(key);
+    uint32_t hash = HT_KEY_HASH(key, len);
+    if (hashtable_find_slot(t, key, hash, len) != HT_NOT_FOUND) {
+        /* Entry exists; fail. */
+        return false;
+    }
+    if ((float) (t->size + 1) / t->capacity > HT_MAX_LOAD) {
+        /* Resize the hash table */
+        hashtable_resize(t, hashtable_double(t->capacity));
+    }
+    hashtable_entry_fill(&entry, key, value, hash, len);
+    hashtable_insert(t, entry);
+    t->size++;
+    return true;
+}
+
+/**
+ * Resize the allocated memory to the given capacity (a power of two).
+ */
+void hashtable_resize(hashtable_t *t, uint32_t capacity) {
+    uint32_t old_capacity = t->capacity;
+    uint8_t *old_dist = t->dist;
+    hashtable_entry_t *old_body = t->body;
+    t->capacity = capacity;
+    t->dist = calloc_or_die(capacity, sizeof(uint8_t));
+    t->body = calloc_or_die(capacity, sizeof(hashtable_entry_t));
+    for (unsigned int i = 0; i < old_capacity; i++) {
+        if (old_dist[i] != 0) {
+            hashtable_insert(t, old_body[i]);
+        }
+    }
+    free(old_dist);
+    free(old_body);
+}
+
+/**
+ * Remove a key from the table
+ * Following entries move one slot back, until an empty slot or an entry
+ * sitting in its home slot is found. The table shrinks once it gets sparse.
+ */
+void hashtable_remove(hashtable_t *t, char *key) {
+    uint32_t len = HT_KEY_LEN(key);
+    size_t idx = hashtable_find_slot(t, key, HT_KEY_HASH(key, len), len);
+    if (idx != HT_NOT_FOUND) {
+        size_t mask = (size_t) t->capacity - 1;
+        size_t next = (idx + 1) & mask;
+        while (t->dist[next] > 1) {
+            t->body[idx] = t->body[next];
+            t->dist[idx] = (uint8_t) (t->dist[next] - 1);
+            idx = next;
+            next = (next + 1) & mask;
+        }
+        t->dist[idx] = 0;
+        hashtable_entry_clear(&t->body[idx]);
+        t->size--;
+        if (hashtable_is_sparse(t->size, t->capacity))
+            hashtable_resize(t, t->capacity / 2);
+    }
+}
+
+/**
+ * Shrink the table to the smallest capacity fitting its entries, e.g. after
+ * bulk removals.
+ */
+void hashtable_compact(hashtable_t *t) {
+    uint32_t capacity = hashtable_fit_capacity(t->size);
+    if (capacity < t->capacity)
+        hashtable_resize(t, capacity);
+}
+
+/**
+ * Iterate through table entries (uses only an int as state memory)
+ * Return NULL if no other element is present
+ */
+void *hashtable_iterate(hashtable_t *table, size_t *state) {
+    register size_t local_state = *state;
+    while (local_state < table->capacity) {
+        if (table->dist[local_state] != 0) {
+            *state = local_state + 1;
+            return table->body[local_state].value;
+        }
+        local_state++;
+    }
+    return NULL;
+}
+
+/**
+ * Destroy the table and deallocate it from memory. This does not deallocate the contained items.
+ */
+void hashtable_destroy(hashtable_t *t) {
+    free(t->dist);
+    free(t->body);
+    free(t);
+}
+
+/**
+ * Return the number of used entries
+ */
+uint32_t hashtable_get_size(hashtable_t *table) {
+    return table->size;
+}
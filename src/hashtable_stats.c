@@ -0,0 +1,181 @@
+/*
+ * Copyright 2017 Francesco Circhetta
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "hashtable_stats.h"
+
+/****************************************************************************
+ * Private Data
+ ****************************************************************************/
+static hashtable_stats_t stats;
+static bool dump_registered = false;
+
+static const char *op_names[HT_STATS_OPS] = {"get", "set", "remove"};
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+static void dump_at_exit(void) {
+    hashtable_stats_dump(stderr);
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+/**
+ * Copy the counters
+ */
+void hashtable_stats_get(hashtable_stats_t *out) {
+    *out = stats;
+}
+
+/**
+ * Zero the event counters. Live tables, entries and slots are kept, they
+ * describe the tables still around, and high-water marks restart from them.
+ */
+void hashtable_stats_reset(void) {
+    uint32_t tables = stats.tables;
+    uint64_t entries = stats.entries, slots = stats.slots;
+    memset(&stats, 0, sizeof(stats));
+    stats.tables = stats.peak_tables = tables;
+    stats.entries = stats.peak_entries = entries;
+    stats.slots = stats.peak_slots = slots;
+}
+
+/**
+ * Print the counters. Called at exit on stderr once a table was created.
+ */
+void hashtable_stats_dump(FILE *out) {
+    fprintf(out, "hashtable stats: %u tables, %llu entries in %llu slots (load %.3f)\n",
+            stats.tables, (unsigned long long) stats.entries, (unsigned long long) stats.slots,
+            stats.slots != 0 ? (double) stats.entries / stats.slots : 0.0);
+    fprintf(out, "peak: %u tables, %llu entries in %llu slots (load %.3f)\n",
+            stats.peak_tables, (unsigned long long) stats.peak_entries,
+            (unsigned long long) stats.peak_slots,
+            stats.peak_slots != 0 ? (double) stats.peak_entries / stats.peak_slots : 0.0);
+    fprintf(out, "%-12s", "probes");
+    for (int op = 0; op < HT_STATS_OPS; op++)
+        fprintf(out, " %12s", op_names[op]);
+    fprintf(out, "\n");
+    for (int b = 0; b < HT_STATS_BUCKETS; b++) {
+        uint64_t row = 0;
+        for (int op = 0; op < HT_STATS_OPS; op++)
+            row += stats.probes[op][b];
+        if (row == 0)
+            continue;
+        char range[16];
+        if (b == 0)
+            sprintf(range, "1");
+        else if (b == HT_STATS_BUCKETS - 1)
+            sprintf(range, "%lu+", 1ul << b);
+        else
+            sprintf(range, "%lu-%lu", 1ul << b, (2ul << b) - 1);
+        fprintf(out, "%-12s", range);
+        for (int op = 0; op < HT_STATS_OPS; op++)
+            fprintf(out, " %12llu", (unsigned long long) stats.probes[op][b]);
+        fprintf(out, "\n");
+    }
+    fprintf(out, "%-12s", "mean");
+    for (int op = 0; op < HT_STATS_OPS; op++) {
+        uint64_t count = 0;
+        for (int b = 0; b < HT_STATS_BUCKETS; b++)
+            count += stats.probes[op][b];
+        fprintf(out, " %12.2f", count != 0 ? (double) stats.probes_total[op] / count : 0.0);
+    }
+    fprintf(out, "\n");
+    fprintf(out, "resizes: %llu grows, %llu shrinks, %llu bytes moved\n",
+            (unsigned long long) stats.grows, (unsigned long long) stats.shrinks,
+            (unsigned long long) stats.bytes_moved);
+    fprintf(out, "max cluster: %u slots\n", stats.max_cluster);
+}
+
+/**
+ * A table of the given capacity was created
+ */
+void hashtable_stats_create(uint32_t capacity) {
+    if (!dump_registered) {
+        dump_registered = true;
+        atexit(dump_at_exit);
+    }
+    stats.tables++;
+    if (stats.tables > stats.peak_tables)
+        stats.peak_tables = stats.tables;
+    stats.slots += capacity;
+}
+
+/**
+ * A table of the given size and capacity was destroyed
+ */
+void hashtable_stats_destroy(uint32_t size, uint32_t capacity) {
+    stats.tables--;
+    stats.entries -= size;
+    stats.slots -= capacity;
+}
+
+/**
+ * An operation went through the given number of slots
+ */
+void hashtable_stats_probes(int op, uint32_t probes) {
+    int b = 0;
+    while (b < HT_STATS_BUCKETS - 1 && probes >> (b + 1) != 0)
+        b++;
+    stats.probes[op][b]++;
+    stats.probes_total[op] += probes;
+}
+
+/**
+ * Entries were added (or removed, if negative)
+ */
+void hashtable_stats_entries(int delta) {
+    stats.entries += delta;
+    if (stats.entries > stats.peak_entries) {
+        stats.peak_entries = stats.entries;
+        stats.peak_slots = stats.slots;
+    }
+}
+
+/**
+ * A table changed capacity
+ */
+void hashtable_stats_resize(uint32_t old_capacity, uint32_t capacity) {
+    if (capacity > old_capacity)
+        stats.grows++;
+    else if (capacity < old_capacity)
+        stats.shrinks++;
+    stats.slots += capacity;
+    stats.slots -= old_capacity;
+}
+
+/**
+ * Bytes of entries copied from a body to another
+ */
+void hashtable_stats_moved(uint64_t bytes) {
+    stats.bytes_moved += bytes;
+}
+
+/**
+ * A run of used slots of the given length was found
+ */
+void hashtable_stats_cluster(uint32_t length) {
+    if (length > stats.max_cluster)
+        stats.max_cluster = length;
+}
@@ -0,0 +1,82 @@
+/*
+ * Copyright 2017 Francesco Circhetta
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef API_HASHTABLE_STATS_H
+#define API_HASHTABLE_STATS_H
+
+/**
+ * Counters of the linear engine, summed over every table of the process.
+ * They are only kept when built with HT_STATS (CMake HASHTABLE_STATS=ON):
+ * otherwise the engine references none of this and pays nothing. Besides
+ * the live tables, their high-water marks are kept: a program that frees
+ * its tables before exiting still reports the load they ran at.
+ */
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+#include <stdio.h>
+#include <stdint.h>
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+/* Operations with a probe histogram */
+#define HT_STATS_GET    0
+#define HT_STATS_SET    1
+#define HT_STATS_REMOVE 2
+#define HT_STATS_OPS    3
+
+/* Histogram bucket b counts operations probing [2^b, 2^(b+1)) slots, the
+ * last one everything longer */
+#define HT_STATS_BUCKETS 16
+
+/****************************************************************************
+ * Public Types
+ ****************************************************************************/
+typedef struct _hashtable_stats {
+    uint64_t            probes[HT_STATS_OPS][HT_STATS_BUCKETS];
+    uint64_t            probes_total[HT_STATS_OPS];     /* Slots probed */
+    uint64_t            grows;
+    uint64_t            shrinks;
+    uint64_t            bytes_moved;    /* Entries copied by resizes */
+    uint32_t            max_cluster;    /* Longest run of used slots seen */
+    uint32_t            tables;         /* Live tables */
+    uint64_t            entries;        /* Entries of the live tables */
+    uint64_t            slots;          /* Capacity of the live tables */
+    uint32_t            peak_tables;    /* Most tables alive at once */
+    uint64_t            peak_entries;   /* Most entries at once */
+    uint64_t            peak_slots;     /* Capacity when entries peaked */
+} hashtable_stats_t;
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+void hashtable_stats_get(hashtable_stats_t *);
+void hashtable_stats_reset(void);
+void hashtable_stats_dump(FILE *);
+
+/* Hooks of the engine */
+void hashtable_stats_create(uint32_t);
+void hashtable_stats_destroy(uint32_t, uint32_t);
+void hashtable_stats_probes(int, uint32_t);
+void hashtable_stats_entries(int);
+void hashtable_stats_resize(uint32_t, uint32_t);
+void hashtable_stats_moved(uint64_t);
+void hashtable_stats_cluster(uint32_t);
+
+#endif //API_HASHTABLE_STATS_H
@@ -0,0 +1,295 @@
+/*
+ * Copyright 2017 Francesco Circhetta
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * Swiss-table style engine.
+ *
+ * Every slot owns a control byte: EMPTY, DELETED or, when the slot is full,
+ * the low 7 bits of the key hash. Slots are probed in aligned groups of
+ * HT_GROUP_WIDTH control bytes, compared all at once (SSE2 when available),
+ * so keys are only compared on slots whose tag matches.
+ */
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "utils.h"
+#include "hash.h"
+#include "hashtable_internal.h"
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+#define HT_GROUP_WIDTH 16
+
+#define HT_CTRL_EMPTY ((uint8_t) 0x80)
+#define HT_CTRL_DELETED ((uint8_t) 0xFE)
+#define HT_CTRL_IS_FULL(c) (((c) & 0x80) == 0)
+
+/* Hash bits selecting the first group and the tag stored in the slot */
+#define HT_H1(hash) ((size_t) ((hash) >> 7))
+#define HT_H2(hash) ((uint8_t) ((hash) & 0x7F))
+
+/* At most 7/8 of the slots may be full or deleted */
+#define HT_MAX_GROWTH(capacity) ((capacity) - (capacity) / 8)
+
+#define HT_NOT_FOUND ((size_t) -1)
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+/**
+ * Index of the lowest set bit of a non-zero mask.
+ */
+static inline unsigned int bit_lowest(uint32_t mask) {
+#ifdef __GNUC__
+    return (unsigned int) __builtin_ctz(mask);
+#else
+    unsigned int i = 0;
+    while ((mask & 1) == 0) {
+        mask >>= 1;
+        i++;
+    }
+    return i;
+#endif
+}
+
+/**
+ * Bitmask of the group slots whose control byte equals the given one.
+ */
+static inline uint32_t group_match(const uint8_t *ctrl, uint8_t c) {
+#ifdef __SSE2__
+    __m128i group = _mm_loadu_si128((const __m128i *) ctrl);
+    return (uint32_t) _mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8((char) c)));
+#else
+    uint32_t mask = 0;
+    for (unsigned int i = 0; i < HT_GROUP_WIDTH; i++) {
+        if (ctrl[i] == c)
+            mask |= (uint32_t) 1 << i;
+    }
+    return mask;
+#endif
+}
+
+/**
+ * Bitmask of the group slots that are either empty or deleted.
+ */
+static inline uint32_t group_match_free(const uint8_t *ctrl) {
+#ifdef __SSE2__
+    /* Free control bytes are exactly the ones with the high bit set */
+    return (uint32_t) _mm_movemask_epi8(_mm_loadu_si128((const __m128i *) ctrl));
+#else
+    uint32_t mask = 0;
+    for (unsigned int i = 0; i < HT_GROUP_WIDTH; i++) {
+        if (!HT_CTRL_IS_FULL(ctrl[i]))
+            mask |= (uint32_t) 1 << i;
+    }
+    return mask;
+#endif
+}
+
+/**
+ * Find the slot holding the given key, or HT_NOT_FOUND.
+ * Groups are visited with triangular probing, which covers every group
+ * of a power-of-two table.
+ */
+static size_t hashtable_find_slot(hashtable_t *t, const char *key,
+                                  uint32_t hash, uint32_t len) {
+    size_t groups_mask = t->capacity / HT_GROUP_WIDTH - 1;
+    size_t group = HT_H1(hash) & groups_mask;
+    uint8_t tag = HT_H2(hash);
+    for (size_t step = 1;; step++) {
+        const uint8_t *ctrl = t->ctrl + group * HT_GROUP_WIDTH;
+        uint32_t mask = group_match(ctrl, tag);
+        while (mask) {
+            size_t idx = group * HT_GROUP_WIDTH + bit_lowest(mask);
+            if (hashtable_entry_matches(&t->body[idx], key, hash, len))
+                return idx;
+            mask &= mask - 1;
+        }
+        /* An empty slot ends every probe sequence going through this group */
+        if (group_match(ctrl, HT_CTRL_EMPTY))
+            return HT_NOT_FOUND;
+        group = (group + step) & groups_mask;
+    }
+}
+
+/**
+ * Find the first empty or deleted slot along the probe sequence of a hash.
+ */
+static size_t hashtable_find_free_slot(hashtable_t *t, uint32_t hash) {
+    size_t groups_mask = t->capacity / HT_GROUP_WIDTH - 1;
+    size_t group = HT_H1(hash) & groups_mask;
+    for (size_t step = 1;; step++) {
+        uint32_t mask = group_match_free(t->ctrl + group * HT_GROUP_WIDTH);
+        if (mask)
+            return group * HT_GROUP_WIDTH + bit_lowest(mask);
+        group = (group + step) & groups_mask;
+    }
+}
+
+/**
+ * Allocate new control bytes and slots with the given capacity.
+ */
+static inline void hashtable_body_allocate(hashtable_t *t, uint32_t capacity) {
+    t->capacity = capacity;
+    t->growth_left = (uint32_t) HT_MAX_GROWTH(capacity);
+    t->ctrl = malloc_or_die(capacity * sizeof(uint8_t));
+    memset(t->ctrl, HT_CTRL_EMPTY, capacity);
+    t->body = (hashtable_entry_t *) calloc_or_die(capacity, sizeof(hashtable_entry_t));
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+/**
+ * Create a new, empty hashtable
+ */
+hashtable_t *hashtable_create(void) {
+    hashtable_t *new_ht = malloc_or_die(sizeof(hashtable_t));
+    new_ht->size = 0;
+    hashtable_body_allocate(new_ht, HT_INITIAL_CAPACITY);
+    return new_ht;
+}
+
+/**
+ * Return the item associated with the given key, or NULL if not found.
+ */
+void *hashtable_get(hashtable_t *table, char *key) {
+    uint32_t len = HT_KEY_LEN(key);
+    size_t idx = hashtable_find_slot(table, key, HT_KEY_HASH(key, len), len);
+    return idx == HT_NOT_FOUND ? NULL : table->body[idx].value;
+}
+
+/**
+ * Assign a value to the given key in the table.
+ */
+bool hashtable_set(hashtable_t *t, char *key, void *value) {
+    uint32_t len = HT_KEY_LEN(key);
+    uint32_t hash = HT_KEY_HASH(key, len);
+    if (hashtable_find_slot(t, key, hash, len) != HT_NOT_FOUND) {
+        /* Entry exists; fail. */
+        return false;
+    }
+    if (t->growth_left == 0) {
+        /* Grow if the table is really full, otherwise just drop tombstones */
+        if (t->size + 1 > HT_MAX_GROWTH(t->capacity) / 2)
+            hashtable_resize(t, hashtable_double(t->capacity));
+        else
+            hashtable_resize(t, t->capacity);
+    }
+    size_t idx = hashtable_find_free_slot(t, hash);
+    if (t->ctrl[idx] == HT_CTRL_EMPTY)
+        t->growth_left--;
+    t->ctrl[idx] = HT_H2(hash);
+    hashtable_entry_fill(&t->body[idx], key, value, hash, len);
+    t->size++;
+    return true;
+}
+
+/**
+ * Rebuild the table with the given capacity (a power of two, at least
+ * HT_GROUP_WIDTH), keeping every entry and dropping tombstones.
+ */
+void hashtable_resize(hashtable_t *t, uint32_t capacity) {
+    uint32_t old_capacity = t->capacity;
+    uint8_t *old_ctrl = t->ctrl;
+    hashtable_entry_t *old_body = t->body;
+    hashtable_body_allocate(t, capacity);
+    for (unsigned int i = 0; i < old_capacity; i++) {
+        if (HT_CTRL_IS_FULL(old_ctrl[i])) {
+            size_t idx = hashtable_find_free_slot(t, old_body[i].hash);
+            t->ctrl[idx] = HT_H2(old_body[i].hash);
+            t->body[idx] = old_body[i];
+            t->growth_left--;
+        }
+    }
+    free(old_ctrl);
+    free(old_body);
+}
+
+/**
+ * Remove a key from the table
+ * The slot becomes empty when its group still has an empty slot (no probe
+ * sequence can go past that group), otherwise it is marked as deleted.
+ * The table shrinks once it gets sparse.
+ */
+void hashtable_remove(hashtable_t *t, char *key) {
+    uint32_t len = HT_KEY_LEN(key);
+    size_t idx = hashtable_find_slot(t, key, HT_KEY_HASH(key, len), len);
+    if (idx != HT_NOT_FOUND) {
+        const uint8_t *group = t->ctrl + idx / HT_GROUP_WIDTH * HT_GROUP_WIDTH;
+        if (group_match(group, HT_CTRL_EMPTY)) {
+            t->ctrl[idx] = HT_CTRL_EMPTY;
+            t->growth_left++;
+        } else {
+            t->ctrl[idx] = HT_CTRL_DELETED;
+        }
+        hashtable_entry_clear(&t->body[idx]);
+        t->size--;
+        if (hashtable_is_sparse(t->size, t->capacity))
+            hashtable_resize(t, t->capacity / 2);
+    }
+}
+
+/**
+ * Rebuild the table with the smallest capacity fitting its entries, e.g.
+ * after bulk removals. Tombstones are dropped even if the capacity stays.
+ */
+void hashtable_compact(hashtable_t *t) {
+    uint32_t capacity = hashtable_fit_capacity(t->size);
+    if (capacity < t->capacity || t->growth_left < HT_MAX_GROWTH(t->capacity) - t->size)
+        hashtable_resize(t, capacity < t->capacity ? capacity : t->capacity);
+}
+
+/**
+ * Iterate through table entries (uses only an int as state memory)
+ * Return NULL if no other element is present
+ */
+void *hashtable_iterate(hashtable_t *table, size_t *state) {
+    register size_t local_state = *state;
+    while (local_state < table->capacity) {
+        if (HT_CTRL_IS_FULL(table->ctrl[local_state])) {
+            *state = local_state + 1;
+            return table->body[local_state].value;
+        }
+        local_state++;
+    }
+    return NULL;
+}
+
+/**
+ * Destroy the table and deallocate it from memory. This does not deallocate the contained items.
+ */
+void hashtable_destroy(hashtable_t *t) {
+    free(t->ctrl);
+    free(t->body);
+    free(t);
+}
+
+/**
+ * Return the number of used entries
+ */
+uint32_t hashtable_get_size(hashtable_t *table) {
+    return table->size;
+}
@@ -0,0 +1,308 @@
+/*
+ * Copyright 2017 Francesco Circhetta
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * Hashtable generator, the C99 take on a template.
+ *
+ * Every inclusion of this header generates one linear probing table,
+ * specialized for its key and value types, hash and equality, with all of
+ * its functions static inline so that they fold into their callers:
+ *
+ *     #define HT_T_NAME       idmap           (idmap_t, idmap_set(), ...)
+ *     #define HT_T_KEY        uint64_t
+ *     #define HT_T_VALUE      node_t *
+ *     #define HT_T_HASH(k)    mix64(k)        (any integer, truncated)
+ *     #define HT_T_EQUAL(a, b) ((a) == (b))
+ *     #include "hashtable_template.h"
+ *
+ * Optional parameters:
+ *  - HT_T_KEY_OF(v): the key is read through the value, entries store the
+ *    value and its hash only (like HT_KEYLESS)
+ *  - HT_T_INITIAL_CAPACITY (32), HT_T_MAX_LOAD (0.8), HT_T_MIN_LOAD (0.2):
+ *    the table doubles above HT_T_MAX_LOAD and halves below HT_T_MIN_LOAD
+ *  - HT_T_ALLOC(bytes), HT_T_FREE(ptr, bytes): body allocation, which must
+ *    come zeroed (calloc_or_die() and free() by default)
+ *
+ * Entries cache their hash, 0 marking an empty slot (hashes of 0 are
+ * stored as 1), and removals shift the following entries back. All the
+ * parameters are undefined at the end, ready for the next instance.
+ */
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "utils.h"
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+#if !defined(HT_T_NAME) || !defined(HT_T_KEY) || !defined(HT_T_VALUE) \
+    || !defined(HT_T_HASH) || !defined(HT_T_EQUAL)
+#error "HT_T_NAME, HT_T_KEY, HT_T_VALUE, HT_T_HASH and HT_T_EQUAL must be defined"
+#endif
+
+#ifndef HT_T_INITIAL_CAPACITY
+#define HT_T_INITIAL_CAPACITY 32
+#endif
+#ifndef HT_T_MAX_LOAD
+#define HT_T_MAX_LOAD 0.8
+#endif
+#ifndef HT_T_MIN_LOAD
+#define HT_T_MIN_LOAD 0.2
+#endif
+#ifndef HT_T_ALLOC
+#define HT_T_ALLOC(bytes) calloc_or_die(1, (bytes))
+#endif
+#ifndef HT_T_FREE
+#define HT_T_FREE(ptr, bytes) free(ptr)
+#endif
+
+#define HT_T_CAT2(a, b) a##_##b
+#define HT_T_CAT(a, b) HT_T_CAT2(a, b)
+#define HT_T_FN(f) HT_T_CAT(HT_T_NAME, f)
+#define HT_T_TABLE HT_T_CAT(HT_T_NAME, t)
+#define HT_T_ENTRY HT_T_CAT(HT_T_NAME, entry_t)
+
+/****************************************************************************
+ * Public Types
+ ****************************************************************************/
+typedef struct {
+#ifndef HT_T_KEY_OF
+    HT_T_KEY            key;
+#endif
+    HT_T_VALUE          value;
+    uint32_t            hash;           /* 0 if the slot is empty */
+} HT_T_ENTRY;
+
+typedef struct {
+    uint32_t            size;
+    uint32_t            capacity;
+    HT_T_ENTRY          *body;
+} HT_T_TABLE;
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+/**
+ * Hash of a key, never 0
+ */
+static inline uint32_t HT_T_FN(hash_key)(HT_T_KEY key) {
+    uint32_t hash = (uint32_t) (HT_T_HASH(key));
+    return hash != 0 ? hash : 1;
+}
+
+/**
+ * Key of a used entry
+ */
+static inline HT_T_KEY HT_T_FN(entry_key)(HT_T_ENTRY *entry) {
+#ifdef HT_T_KEY_OF
+    return HT_T_KEY_OF(entry->value);
+#else
+    return entry->key;
+#endif
+}
+
+/**
+ * Slot holding the given key or, if missing, the empty slot where it would go
+ */
+static inline HT_T_ENTRY *HT_T_FN(find_slot)(HT_T_TABLE *t, HT_T_KEY key, uint32_t hash) {
+    size_t mask = (size_t) t->capacity - 1;
+    size_t idx = hash & mask;
+    HT_T_ENTRY *entry;
+    while ((entry = &t->body[idx])->hash != 0
+           && !(entry->hash == hash && HT_T_EQUAL(HT_T_FN(entry_key)(entry), key)))
+        idx = (idx + 1) & mask;
+    return entry;
+}
+
+/**
+ * Place an entry known to be missing from the table
+ */
+static inline void HT_T_FN(insert)(HT_T_TABLE *t, HT_T_ENTRY entry) {
+    size_t mask = (size_t) t->capacity - 1;
+    size_t idx = entry.hash & mask;
+    while (t->body[idx].hash != 0)
+        idx = (idx + 1) & mask;
+    t->body[idx] = entry;
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+/**
+ * Move the entries to a body of the given capacity (a power of two), by
+ * their cached hash
+ */
+static inline void HT_T_FN(resize)(HT_T_TABLE *t, uint32_t capacity) {
+    uint32_t old_capacity = t->capacity;
+    HT_T_ENTRY *old_body = t->body;
+    t->capacity = capacity;
+    t->body = HT_T_ALLOC((size_t) capacity * sizeof(HT_T_ENTRY));
+    for (uint32_t i = 0; i < old_capacity; i++) {
+        if (old_body[i].hash != 0)
+            HT_T_FN(insert)(t, old_body[i]);
+    }
+    HT_T_FREE(old_body, (size_t) old_capacity * sizeof(HT_T_ENTRY));
+}
+
+/**
+ * Set up an empty table in place
+ */
+static inline void HT_T_FN(init)(HT_T_TABLE *t) {
+    t->size = 0;
+    t->capacity = HT_T_INITIAL_CAPACITY;
+    t->body = HT_T_ALLOC((size_t) t->capacity * sizeof(HT_T_ENTRY));
+}
+
+/**
+ * Release the body of a table set up in place. This does not deallocate
+ * the contained items.
+ */
+static inline void HT_T_FN(release)(HT_T_TABLE *t) {
+    HT_T_FREE(t->body, (size_t) t->capacity * sizeof(HT_T_ENTRY));
+    t->body = NULL;
+}
+
+/**
+ * Create a new, empty table
+ */
+static inline HT_T_TABLE *HT_T_FN(create)(void) {
+    HT_T_TABLE *t = malloc_or_die(sizeof(HT_T_TABLE));
+    HT_T_FN(init)(t);
+    return t;
+}
+
+/**
+ * Destroy the table and deallocate it from memory
+ */
+static inline void HT_T_FN(destroy)(HT_T_TABLE *t) {
+    HT_T_FN(release)(t);
+    free(t);
+}
+
+/**
+ * Return the address of the value of the given key, or NULL if not found
+ */
+static inline HT_T_VALUE *HT_T_FN(find)(HT_T_TABLE *t, HT_T_KEY key) {
+    HT_T_ENTRY *entry = HT_T_FN(find_slot)(t, key, HT_T_FN(hash_key)(key));
+    return entry->hash != 0 ? &entry->value : NULL;
+}
+
+/**
+ * Assign a value to the given key.
+ * Return false if the key is already taken.
+ */
+static inline bool HT_T_FN(set)(HT_T_TABLE *t, HT_T_KEY key, HT_T_VALUE value) {
+    uint32_t hash = HT_T_FN(hash_key)(key);
+    HT_T_ENTRY *entry = HT_T_FN(find_slot)(t, key, hash);
+    if (entry->hash != 0)
+        return false;
+    if ((float) (t->size + 1) / t->capacity > HT_T_MAX_LOAD) {
+        if (t->capacity > UINT32_MAX / 2)
+            exit(-1);
+        HT_T_FN(resize)(t, t->capacity * 2);
+        entry = HT_T_FN(find_slot)(t, key, hash);
+    }
+#ifndef HT_T_KEY_OF
+    entry->key = key;
+#endif
+    entry->value = value;
+    entry->hash = hash;
+    t->size++;
+    return true;
+}
+
+/**
+ * Remove a key. Following entries move back not to break their probe
+ * sequence, and the table halves once it gets sparse.
+ * Return false if the key was not found.
+ */
+static inline bool HT_T_FN(remove)(HT_T_TABLE *t, HT_T_KEY key) {
+    HT_T_ENTRY *entry = HT_T_FN(find_slot)(t, key, HT_T_FN(hash_key)(key));
+    if (entry->hash == 0)
+        return false;
+    size_t mask = (size_t) t->capacity - 1;
+    size_t idx = (size_t) (entry - t->body);
+    size_t next = (idx + 1) & mask;
+    while (t->body[next].hash != 0) {
+        size_t home = t->body[next].hash & mask;
+        if (((next - home) & mask) >= ((next - idx) & mask)) {
+            t->body[idx] = t->body[next];
+            idx = next;
+        }
+        next = (next + 1) & mask;
+    }
+    t->body[idx].hash = 0;
+    t->size--;
+    if (t->capacity > HT_T_INITIAL_CAPACITY
+        && (float) t->size / t->capacity < HT_T_MIN_LOAD)
+        HT_T_FN(resize)(t, t->capacity / 2);
+    return true;
+}
+
+/**
+ * Shrink the table to the smallest capacity fitting its entries, e.g. after
+ * bulk removals
+ */
+static inline void HT_T_FN(compact)(HT_T_TABLE *t) {
+    uint32_t capacity = HT_T_INITIAL_CAPACITY;
+    while ((float) t->size / capacity > HT_T_MAX_LOAD / 2)
+        capacity *= 2;
+    if (capacity < t->capacity)
+        HT_T_FN(resize)(t, capacity);
+}
+
+/**
+ * Iterate through the values (uses only an int as state memory)
+ * Return NULL if no other value is present
+ */
+static inline HT_T_VALUE *HT_T_FN(iterate)(HT_T_TABLE *t, size_t *state) {
+    for (size_t idx = *state; idx < t->capacity; idx++) {
+        if (t->body[idx].hash != 0) {
+            *state = idx + 1;
+            return &t->body[idx].value;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Return the number of entries
+ */
+static inline uint32_t HT_T_FN(get_size)(HT_T_TABLE *t) {
+    return t->size;
+}
+
+#undef HT_T_NAME
+#undef HT_T_KEY
+#undef HT_T_VALUE
+#undef HT_T_HASH
+#undef HT_T_EQUAL
+#undef HT_T_KEY_OF
+#undef HT_T_INITIAL_CAPACITY
+#undef HT_T_MAX_LOAD
+#undef HT_T_MIN_LOAD
+#undef HT_T_ALLOC
+#undef HT_T_FREE
+#undef HT_T_CAT2
+#undef HT_T_CAT
+#undef HT_T_FN
+#undef HT_T_TABLE
+#undef HT_T_ENTRY
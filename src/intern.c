@@ -0,0 +1,108 @@
+/*
+ * Copyright 2017 Francesco Circhetta
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * Process-wide string interning.
+ *
+ * Every distinct string is stored once, with its length and hash, in a
+ * record owned by a linear probing table (an instance of
+ * hashtable_template.h keyed through the record). Interned strings compare
+ * by pointer, and a string that was never interned cannot be the name of
+ * anything: looking it up fails without probing any directory.
+ */
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+#include <string.h>
+
+#include "utils.h"
+#include "hash.h"
+#include "intern.h"
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+/* intern_table_t, the records by string */
+#define HT_T_NAME intern_table
+#define HT_T_KEY const char *
+#define HT_T_VALUE intern_t *
+#define HT_T_KEY_OF(record) ((const char *) (record)->str)
+#define HT_T_HASH(k) hash_string((k), strlen(k))
+#define HT_T_EQUAL(a, b) (strcmp((a), (b)) == 0)
+#include "hashtable_template.h"
+
+/****************************************************************************
+ * Private Data
+ ****************************************************************************/
+/* Allocated on the first string */
+static intern_table_t strings = { 0, 0, NULL };
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+/**
+ * Return the interned copy of a string, or NULL if it is not interned
+ */
+const char *intern_get(const char *str) {
+    if (strings.size == 0)
+        return NULL;
+    intern_t **record = intern_table_find(&strings, str);
+    return record != NULL ? (*record)->str : NULL;
+}
+
+/**
+ * Return the interned copy of a string of the given length, interning it
+ * if needed, and take a reference to it
+ */
+const char *intern_acquire(const char *str, size_t len) {
+    if (strings.body == NULL)
+        intern_table_init(&strings);
+    intern_t **found = intern_table_find(&strings, str);
+    intern_t *record;
+    if (found != NULL) {
+        record = *found;
+    } else {
+        record = malloc_or_die(sizeof(intern_t) + len + 1);
+        record->refs = 0;
+        record->len = (uint32_t) len;
+        record->hash = hash_string(str, len);
+        memcpy(record->str, str, len + 1);
+        intern_table_set(&strings, record->str, record);
+    }
+    record->refs++;
+    return record->str;
+}
+
+/**
+ * Drop a reference to an interned string, which is freed with the last one
+ */
+void intern_release(const char *str) {
+    intern_t *record = intern_record(str);
+    if (--record->refs == 0) {
+        intern_table_remove(&strings, record->str);
+        free(record);
+        if (strings.size == 0)
+            intern_table_release(&strings);
+    }
+}
+
+/**
+ * Return the number of distinct strings
+ */
+uint32_t intern_get_size(void) {
+    return strings.size;
+}
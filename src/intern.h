@@ -0,0 +1,65 @@
+/*
+ * Copyright 2017 Francesco Circhetta
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef API_INTERN_H
+#define API_INTERN_H
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+#include <stdint.h>
+#include <stddef.h>
+
+/****************************************************************************
+ * Public Types
+ ****************************************************************************/
+/* An interned string, reference counted. The string is what callers get:
+ * equal strings are the same pointer, and their record is right before. */
+typedef struct _intern {
+    uint32_t            refs;
+    uint32_t            len;
+    uint64_t            hash;           /* hash_string() of the string */
+    char                str[];
+} intern_t;
+
+/****************************************************************************
+ * Inline Functions
+ ****************************************************************************/
+/**
+ * Record of an interned string
+ */
+static inline intern_t *intern_record(const char *str) {
+    return (intern_t *) (str - offsetof(intern_t, str));
+}
+
+static inline uint64_t intern_hash(const char *str) {
+    return intern_record(str)->hash;
+}
+
+static inline size_t intern_len(const char *str) {
+    return intern_record(str)->len;
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+const char *intern_get(const char *);
+const char *intern_acquire(const char *, size_t);
+void intern_release(const char *);
+uint32_t intern_get_size(void);
+
+#endif //API_INTERN_H
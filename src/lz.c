@@ -0,0 +1,225 @@
+/*
+ * Copyright 2017 Francesco Circhetta
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * LZ77 block codec in the LZ4 block format.
+ *
+ * A block is a run of sequences: a token byte with the number of literals
+ * in its high nibble and the match length minus 4 in the low one (15 means
+ * more length bytes follow, adding up to the first one below 255), the
+ * literals, then the match as a 2-byte little-endian offset back into the
+ * output. The last sequence has literals only, and ends the block.
+ *
+ * The compressor is greedy and single pass: 4-byte sequences are hashed
+ * into a table of their last position, so it runs at memory speed and
+ * skips faster over data that does not compress. The decompressor checks
+ * every length and offset against both buffers, so a corrupted block
+ * fails instead of writing out of bounds.
+ */
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+#include <stdint.h>
+#include <string.h>
+
+#include "lz.h"
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+#define LZ_HASH_LOG 12
+#define LZ_MIN_MATCH 4
+#define LZ_MAX_OFFSET 65535
+/* The last bytes are always literals, and no match starts this close to
+ * the end, as in LZ4 */
+#define LZ_LAST_LITERALS 5
+#define LZ_MATCH_LIMIT 12
+/* Misses before the search step grows by one */
+#define LZ_SKIP_LOG 6
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+static inline uint32_t lz_read32(const uint8_t *p) {
+    uint32_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static inline uint32_t lz_hash(uint32_t sequence) {
+    return (sequence * 2654435761U) >> (32 - LZ_HASH_LOG);
+}
+
+/**
+ * Write a length beyond its nibble. Return NULL if it does not fit.
+ */
+static uint8_t *lz_put_length(uint8_t *op, uint8_t *oend, size_t length) {
+    for (; length >= 255; length -= 255) {
+        if (op == oend)
+            return NULL;
+        *op++ = 255;
+    }
+    if (op == oend)
+        return NULL;
+    *op++ = (uint8_t) length;
+    return op;
+}
+
+/**
+ * Write a sequence: literals, and a match unless offset is 0. Return NULL
+ * if it does not fit.
+ */
+static uint8_t *lz_put_sequence(uint8_t *op, uint8_t *oend, const uint8_t *literals,
+                                size_t nliterals, size_t offset, size_t match) {
+    if (op == oend)
+        return NULL;
+    uint8_t *token = op++;
+    *token = (uint8_t) ((nliterals < 15 ? nliterals : 15) << 4);
+    if (nliterals >= 15 && (op = lz_put_length(op, oend, nliterals - 15)) == NULL)
+        return NULL;
+    if ((size_t) (oend - op) < nliterals)
+        return NULL;
+    memcpy(op, literals, nliterals);
+    op += nliterals;
+    if (offset == 0)
+        return op;
+    if (oend - op < 2)
+        return NULL;
+    *op++ = (uint8_t) offset;
+    *op++ = (uint8_t) (offset >> 8);
+    match -= LZ_MIN_MATCH;
+    *token |= (uint8_t) (match < 15 ? match : 15);
+    if (match >= 15 && (op = lz_put_length(op, oend, match - 15)) == NULL)
+        return NULL;
+    return op;
+}
+
+/**
+ * Read a length beyond its nibble. Return false past the end of the input.
+ */
+static bool lz_get_length(const uint8_t **ip, const uint8_t *iend, size_t *length) {
+    uint8_t byte;
+    do {
+        if (*ip == iend)
+            return false;
+        byte = *(*ip)++;
+        *length += byte;
+    } while (byte == 255);
+    return true;
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+/**
+ * Compress len bytes of src into dst, of capacity bytes (LZ_BOUND(len)
+ * always fits). Return the compressed size, or 0 if it did not fit.
+ */
+size_t lz_compress(const char *src, size_t len, char *dst, size_t capacity) {
+    const uint8_t *base = (const uint8_t *) src;
+    const uint8_t *ip = base, *anchor = base, *end = base + len;
+    uint8_t *op = (uint8_t *) dst, *oend = op + capacity;
+    if (len > UINT32_MAX)
+        return 0;
+    if (len > LZ_MATCH_LIMIT) {
+        uint32_t table[1 << LZ_HASH_LOG] = { 0 };
+        const uint8_t *search_end = end - LZ_MATCH_LIMIT;
+        const uint8_t *match_end = end - LZ_LAST_LITERALS;
+        size_t misses = 0;
+        ip++;
+        while (ip < search_end) {
+            uint32_t sequence = lz_read32(ip);
+            uint32_t hash = lz_hash(sequence);
+            const uint8_t *ref = base + table[hash];
+            table[hash] = (uint32_t) (ip - base);
+            if (ref >= ip || ip - ref > LZ_MAX_OFFSET || lz_read32(ref) != sequence) {
+                ip += 1 + (misses++ >> LZ_SKIP_LOG);
+                continue;
+            }
+            /* Extend the match both ways */
+            const uint8_t *next = ip + LZ_MIN_MATCH, *ref_next = ref + LZ_MIN_MATCH;
+            while (next < match_end && *next == *ref_next) {
+                next++;
+                ref_next++;
+            }
+            while (ip > anchor && ref > base && ip[-1] == ref[-1]) {
+                ip--;
+                ref--;
+            }
+            op = lz_put_sequence(op, oend, anchor, (size_t) (ip - anchor), (size_t) (ip - ref),
+                                 (size_t) (next - ip));
+            if (op == NULL)
+                return 0;
+            ip = anchor = next;
+            misses = 0;
+        }
+    }
+    op = lz_put_sequence(op, oend, anchor, (size_t) (end - anchor), 0, 0);
+    return op != NULL ? (size_t) (op - (uint8_t *) dst) : 0;
+}
+
+/**
+ * Decompress a block of size bytes into dst, which must come out exactly
+ * len bytes long. Return false if the block is corrupted.
+ */
+bool lz_decompress(const char *src, size_t size, char *dst, size_t len) {
+    const uint8_t *ip = (const uint8_t *) src, *iend = ip + size;
+    uint8_t *op = (uint8_t *) dst, *oend = op + len;
+    while (ip < iend) {
+        uint8_t token = *ip++;
+        size_t nliterals = token >> 4;
+        if (nliterals == 15 && !lz_get_length(&ip, iend, &nliterals))
+            return false;
+        if (nliterals > (size_t) (iend - ip) || nliterals > (size_t) (oend - op))
+            return false;
+        if (nliterals <= 16 && iend - ip >= 16 && oend - op >= 16)
+            memcpy(op, ip, 16);     /* A fixed size copies faster */
+        else
+            memcpy(op, ip, nliterals);
+        op += nliterals;
+        ip += nliterals;
+        if (ip == iend)
+            break;
+        if (iend - ip < 2)
+            return false;
+        size_t offset = (size_t) ip[0] | (size_t) ip[1] << 8;
+        ip += 2;
+        size_t match = token & 15;
+        if (match == 15 && !lz_get_length(&ip, iend, &match))
+            return false;
+        match += LZ_MIN_MATCH;
+        if (offset == 0 || offset > (size_t) (op - (uint8_t *) dst)
+            || match > (size_t) (oend - op))
+            return false;
+        const uint8_t *ref = op - offset;
+        if (match <= 24 && offset >= 8 && oend - op >= 24) {
+            /* Short match: whole words, each one read before written */
+            memcpy(op, ref, 8);
+            memcpy(op + 8, ref + 8, 8);
+            memcpy(op + 16, ref + 16, 8);
+            op += match;
+        } else if (offset >= match) {
+            memcpy(op, ref, match);
+            op += match;
+        } else {
+            /* Overlapping: a repeated pattern */
+            while (match--)
+                *op++ = *ref++;
+        }
+    }
+    return op == oend;
+}
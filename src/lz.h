@@ -0,0 +1,39 @@
+/*
+ * Copyright 2017 Francesco Circhetta
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef API_LZ_H
+#define API_LZ_H
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+#include <stdbool.h>
+#include <stddef.h>
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+/* Largest compressed size of len bytes */
+#define LZ_BOUND(len) ((len) + (len) / 255 + 16)
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+size_t lz_compress(const char *, size_t, char *, size_t);
+bool lz_decompress(const char *, size_t, char *, size_t);
+
+#endif //API_LZ_H
@@ -25,11 +25,20 @@
 /****************************************************************************
  * Included Files
  ****************************************************************************/
+#include <stdlib.h>
 #include <string.h>
+#include <ctype.h>
+#include <errno.h>
 #include <stdio.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include <unistd.h>
 #include "simplefs.h"
+#include "reader.h"
+#ifdef HT_STATS
+#include <signal.h>
+#include "hashtable_stats.h"
+#endif
 
 /****************************************************************************
  * Pre-processor Definitions
@@ -45,9 +54,29 @@
 #define TOK_PATH_START " /\n\r\t"
 #define TOK_CONTENT "\"\n\r\t"
 
+/* Contents of a write from this size on are given to the file as read,
+ * smaller ones are copied and their buffer reused */
+#define ADOPT_MIN (64 * 1024)
+
+/****************************************************************************
+ * Private Data
+ ****************************************************************************/
+#ifdef HT_STATS
+/* Set by SIGUSR1: the hashtable counters are printed before the next
+ * command, e.g. on kill -USR1 while a long journal runs */
+static volatile sig_atomic_t stats_requested = 0;
+#endif
+
 /****************************************************************************
  * Private Functions
  ****************************************************************************/
+#ifdef HT_STATS
+static void request_stats(int signum) {
+    (void) signum;
+    stats_requested = 1;
+}
+#endif
+
 /**
  * Find resource by its path string.
  * Function behaves differently based on new_name value:
@@ -68,7 +97,8 @@ node_t *enter_path(node_t *node, char *path, char **new_name) {
     while (cur_token) {
         /* Enter only if current node is a dir */
         if (fs_get_type(node) != Dir) return NULL;
-        if ((tmp = fs_find_in_dir(node, cur_token))) {
+        /* Look the component up once, then probe the directory with it */
+        if ((tmp = fs_find_name(node, fs_lookup_name(cur_token)))) {
             /* Resource found, get next token */
             node = tmp;
             cur_token = next_token;
@@ -125,12 +155,60 @@ void do_write(node_t *node) {
     if (node != NULL
         && new_content != NULL
         && fs_set_file_content(node, new_content)) {
-        printf(RES_WRITE((int) strlen(new_content)));
+        printf(RES_WRITE((int) fs_get_file_size(node)));
         return;
     }
     printf(RES_FAIL);
 }
 
+/**
+ * Whether a line read up to its first quote is `write <path> "`, with the
+ * content still unread and left to do_write_content()
+ */
+bool is_write_head(char *line, int n) {
+    return n >= 9 && line[n - 1] == '"' && line[n - 2] == ' '
+           && strncmp(line, "write ", 6) == 0
+           && strcspn(line + 6, TOK_SPACE) == (size_t) n - 8;
+}
+
+/**
+ * write <path> "<content>"
+ * Same as do_write(), the content read from the input into its own buffer.
+ * Large ones are given to the file: the next write gets a new buffer, of
+ * the same capacity. A file overwritten lends its old buffer to be read
+ * into, so its two contents are never in memory together.
+ */
+void do_write_content(node_t *node, char *head, reader_t *input, char **content,
+                      size_t *capacity) {
+    strtok(head, TOK_SPACE); /* write */
+    node = enter_path(node, strtok(NULL, TOK_SPACE), NULL);
+    if (node != NULL) {
+        size_t old_capacity;
+        char *old = fs_take_file_content(node, &old_capacity);
+        if (old != NULL) {
+            free(*content);
+            *content = old;
+            *capacity = old_capacity;
+        }
+    }
+    size_t len;
+    int end = reader_getfield(input, content, capacity, &len, TOK_CONTENT);
+    if (end != '\n' && end != EOF)
+        reader_skipline(input); /* The rest of the line is ignored */
+    if (node != NULL && fs_get_type(node) == File) {
+        if (len >= ADOPT_MIN && fs_adopt_file_content(node, *content, len, *capacity)) {
+            *content = NULL;
+            printf(RES_WRITE((int) fs_get_file_size(node)));
+            return;
+        }
+        if (fs_set_file_content(node, *content)) {
+            printf(RES_WRITE((int) fs_get_file_size(node)));
+            return;
+        }
+    }
+    printf(RES_FAIL);
+}
+
 /**
  * delete <path>
  * delete_r <path>
@@ -161,8 +239,13 @@ void do_find(node_t *root) {
             paths[i] = fs_get_path(res[i], 0);
         }
         free(res);
-        /* Sort them with quicksort */
-        qsort(paths, nres, sizeof(char *), compare_str);
+        /* Sort them with quicksort, unless ordered directories (FS_DIR_ART)
+         * already gave them in order */
+        size_t sorted = 1;
+        while (sorted < nres && strcmp(paths[sorted - 1], paths[sorted]) < 0)
+            sorted++;
+        if (sorted < nres)
+            qsort(paths, nres, sizeof(char *), compare_str);
         for(size_t i = 0; i < nres; i++) {
             printf(RES_FIND(paths[i]));
             free(paths[i]);
@@ -176,13 +259,51 @@ void do_find(node_t *root) {
 /****************************************************************************
  * Public Functions
  ****************************************************************************/
-int main() {
+/**
+ * usage: project [-n nodes]
+ * The journal comes from stdin. With -n, room for that many nodes is made
+ * at once, in one block: a count that is not a number, or that no block
+ * could hold, is refused.
+ */
+int main(int argc, char **argv) {
+    if (argc == 3 && strcmp(argv[1], "-n") == 0) {
+        char *end;
+        errno = 0;
+        unsigned long nodes = strtoul(argv[2], &end, 10);
+        if (!isdigit((unsigned char) argv[2][0]) || *end != '\0' || errno == ERANGE
+                || nodes > SIZE_MAX || !fs_reserve_nodes((size_t) nodes)) {
+            fprintf(stderr, "usage: project [-n nodes]\n");
+            return 1;
+        }
+    }
+#ifdef HT_STATS
+    signal(SIGUSR1, request_stats);
+#endif
     /* Root node init */
     node_t *root = fs_new_root();
     /* Command parser */
-    char *line = NULL;
-    size_t len = 0;
-    while (my_getline(&line, &len) >= 0) {
+    reader_t input;
+    reader_init(&input, STDIN_FILENO);
+    char *line = NULL, *content = NULL;
+    size_t len = 0, capacity = 0;
+    int n;
+    /* Lines are read up to their first quote: the content of a write is
+     * read on its own, any other quote is part of the line */
+    while ((n = reader_getline(&input, &line, &len, 0, '"')) >= 0) {
+#ifdef HT_STATS
+        if (stats_requested) {
+            stats_requested = 0;
+            hashtable_stats_dump(stderr);
+        }
+#endif
+        if (line[n - 1] == '"') {
+            int next = reader_peek(&input);
+            if (is_write_head(line, n) && next != EOF && strchr(TOK_CONTENT, next) == NULL) {
+                do_write_content(root, line, &input, &content, &capacity);
+                continue;
+            }
+            reader_getline(&input, &line, &len, (size_t) n, '\n');
+        }
         char *token = strtok(line, TOK_SPACE);
         if (token) {
             if (strcmp(token, "create") == 0) {
@@ -205,6 +326,8 @@ int main() {
         }
     }
     free(line);
+    free(content);
+    reader_free(&input);
     fs_destroy_root(root);
     return 0;
 }
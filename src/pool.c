@@ -0,0 +1,151 @@
+/*
+ * Copyright 2017 Francesco Circhetta
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * Fixed-size object pool.
+ *
+ * Objects are carved in order from chunks of chunk_objects objects, and
+ * freed ones are pushed on a free list threaded through their first bytes:
+ * allocations reuse the most recently freed object, still warm in cache,
+ * and new ones sit next to the previous ones. Chunks only go back to the
+ * system on pool_release().
+ */
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+#include <stdint.h>
+
+#include "utils.h"
+#include "pool.h"
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+/* Alignment of the objects, enough for pointers and 64-bit integers */
+#define POOL_ALIGN 8
+
+/****************************************************************************
+ * Private Types
+ ****************************************************************************/
+/* Chunk header, followed by its objects */
+typedef struct _pool_chunk {
+    struct _pool_chunk  *next;
+    uint64_t            align;          /* Keeps the objects aligned */
+} pool_chunk_t;
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+/**
+ * Most objects a chunk can have, with its header, in a size_t
+ */
+static size_t pool_max_objects(const pool_t *pool) {
+    return (SIZE_MAX - sizeof(pool_chunk_t)) / pool->object_size;
+}
+
+/**
+ * Add a chunk of the given number of objects, and make it the one new
+ * objects come from. What was left of the previous chunk goes to the free
+ * list.
+ */
+static void pool_add_chunk(pool_t *pool, size_t objects) {
+    /* No allocation could hold them: crash, as on allocation failure */
+    if (objects > pool_max_objects(pool))
+        exit(-1);
+    pool_chunk_t *chunk = malloc_or_die(sizeof(pool_chunk_t) + objects * pool->object_size);
+    for (; pool->next != pool->end; pool->next += pool->object_size) {
+        *(void **) pool->next = pool->free;
+        pool->free = pool->next;
+    }
+    chunk->next = pool->chunks;
+    pool->chunks = chunk;
+    pool->next = (char *) (chunk + 1);
+    pool->end = pool->next + objects * pool->object_size;
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+/**
+ * Set up an empty pool of objects of the given size, allocated by chunks of
+ * the given number of objects
+ */
+void pool_init(pool_t *pool, size_t object_size, size_t chunk_objects) {
+    if (object_size < sizeof(void *))
+        object_size = sizeof(void *);
+    pool->object_size = (object_size + POOL_ALIGN - 1) & ~(size_t) (POOL_ALIGN - 1);
+    pool->chunk_objects = chunk_objects;
+    pool->free = NULL;
+    pool->next = NULL;
+    pool->end = NULL;
+    pool->chunks = NULL;
+    pool->used = 0;
+}
+
+/**
+ * Return an uninitialized object
+ */
+void *pool_alloc(pool_t *pool) {
+    void *object = pool->free;
+    if (object != NULL) {
+        pool->free = *(void **) object;
+    } else {
+        if (pool->next == pool->end)
+            pool_add_chunk(pool, pool->chunk_objects);
+        object = pool->next;
+        pool->next += pool->object_size;
+    }
+    pool->used++;
+    return object;
+}
+
+/**
+ * Give an object back to the pool
+ */
+void pool_free(pool_t *pool, void *object) {
+    *(void **) object = pool->free;
+    pool->free = object;
+    pool->used--;
+}
+
+/**
+ * Make sure that the given number of objects can be allocated without
+ * growing the pool. The objects never handed out so far must suffice, or
+ * they all come from one new chunk. Return false, and leave the pool
+ * alone, when no chunk could hold that many.
+ */
+bool pool_reserve(pool_t *pool, size_t objects) {
+    size_t available = pool->next != NULL ? (size_t) (pool->end - pool->next) / pool->object_size : 0;
+    if (objects <= available)
+        return true;
+    if (objects > pool_max_objects(pool))
+        return false;
+    pool_add_chunk(pool, objects);
+    return true;
+}
+
+/**
+ * Free every chunk, and every object with them. The pool is empty again.
+ */
+void pool_release(pool_t *pool) {
+    while (pool->chunks != NULL) {
+        pool_chunk_t *next = pool->chunks->next;
+        free(pool->chunks);
+        pool->chunks = next;
+    }
+    pool_init(pool, pool->object_size, pool->chunk_objects);
+}
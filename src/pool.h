@@ -0,0 +1,53 @@
+/*
+ * Copyright 2017 Francesco Circhetta
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef API_POOL_H
+#define API_POOL_H
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+#include <stdbool.h>
+#include <stddef.h>
+
+/****************************************************************************
+ * Public Types
+ ****************************************************************************/
+struct _pool_chunk;
+
+/* Allocator of fixed-size objects, carved from large chunks. Freed objects
+ * go to an intrusive free list and are handed out again first. */
+typedef struct _pool {
+    size_t              object_size;    /* Rounded up to pointer alignment */
+    size_t              chunk_objects;  /* Objects of a regular chunk */
+    void                *free;          /* Free list, through the objects */
+    char                *next;          /* Never used space of the last chunk */
+    char                *end;
+    struct _pool_chunk  *chunks;
+    size_t              used;           /* Objects handed out */
+} pool_t;
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+void pool_init(pool_t *, size_t, size_t);
+void *pool_alloc(pool_t *);
+void pool_free(pool_t *, void *);
+bool pool_reserve(pool_t *, size_t);
+void pool_release(pool_t *);
+
+#endif //API_POOL_H
@@ -0,0 +1,235 @@
+/*
+ * Copyright 2017 Francesco Circhetta
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * Buffered reader.
+ *
+ * Input is read in blocks and lines are cut with memchr() rather than one
+ * fgetc() per byte. A field (the content of a write) is read into a buffer
+ * of its own, which the caller may then give away instead of copying it:
+ * once the block is drained, large fields are read straight into their
+ * buffer, and only what follows them in the last read goes back to the
+ * block.
+ */
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <stdbool.h>
+
+#include "utils.h"
+#include "reader.h"
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+/* Bytes read at once, in the block or straight into a field */
+#define READER_BLOCK (256 * 1024)
+#define MIN_CHUNK 64
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+/**
+ * read() what is available, up to count bytes. Return 0 at end of input
+ * or on error.
+ */
+static size_t reader_read(reader_t *reader, char *buffer, size_t count) {
+    ssize_t got;
+    do {
+        got = read(reader->fd, buffer, count);
+    } while (got < 0 && errno == EINTR);
+    return got > 0 ? (size_t) got : 0;
+}
+
+/**
+ * Refill the block once it is drained. Return false at end of input.
+ */
+static bool reader_fill(reader_t *reader) {
+    if (reader->pos < reader->end)
+        return true;
+    reader->pos = 0;
+    reader->end = reader_read(reader, reader->block, READER_BLOCK);
+    return reader->end > 0;
+}
+
+/**
+ * Make room for size bytes in a buffer, at least doubling it. Large blocks
+ * are mapped by malloc, and grow without a copy on Linux (mremap()).
+ */
+static void reader_reserve(char **buffer, size_t *capacity, size_t size) {
+    if (size <= *capacity)
+        return;
+    size_t grown = *capacity > MIN_CHUNK ? *capacity : MIN_CHUNK;
+    while (grown < size)
+        grown *= 2;
+    *buffer = realloc_or_die(*buffer, grown);
+    *capacity = grown;
+}
+
+/**
+ * Length of the bytes before the first delimiter, or n if there is none.
+ * A NUL byte ends a field too, as it would end a C string.
+ */
+static size_t reader_span(const char *bytes, size_t n, const char *delimiters) {
+    const char *found = memchr(bytes, '\0', n);
+    if (found != NULL)
+        n = (size_t) (found - bytes);
+    for (; *delimiters != '\0' && n > 0; delimiters++) {
+        found = memchr(bytes, *delimiters, n);
+        if (found != NULL)
+            n = (size_t) (found - bytes);
+    }
+    return n;
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+/**
+ * Read from a file descriptor
+ */
+void reader_init(reader_t *reader, int fd) {
+    reader->fd = fd;
+    reader->block = malloc_or_die(READER_BLOCK);
+    reader->pos = 0;
+    reader->end = 0;
+}
+
+/**
+ * Release the block. The descriptor is left open.
+ */
+void reader_free(reader_t *reader) {
+    free(reader->block);
+    reader->block = NULL;
+}
+
+/**
+ * Next byte of the input, left unread, or EOF
+ */
+int reader_peek(reader_t *reader) {
+    if (!reader_fill(reader))
+        return EOF;
+    return (unsigned char) reader->block[reader->pos];
+}
+
+/**
+ * Read up to a newline or the stop byte, both included, and NUL-terminate,
+ * like my_getline() does. The bytes are stored from offset from of *line,
+ * which continues a line cut at a stop byte. Return the length of the
+ * whole line, or -1 if the input is over and nothing was stored.
+ */
+int reader_getline(reader_t *reader, char **line, size_t *len, size_t from, char stop) {
+    if (*line == NULL) {
+        *len = MIN_CHUNK;
+        *line = malloc_or_die(MIN_CHUNK * sizeof(char));
+    }
+    size_t n = from;
+    while (reader_fill(reader)) {
+        char *start = reader->block + reader->pos;
+        size_t avail = reader->end - reader->pos;
+        char *found = memchr(start, '\n', avail);
+        if (stop != '\n') {
+            char *stopped = memchr(start, stop, found ? (size_t) (found - start) : avail);
+            if (stopped != NULL)
+                found = stopped;
+        }
+        size_t take = found ? (size_t) (found - start) + 1 : avail;
+        reader_reserve(line, len, n + take + 1);
+        memcpy(*line + n, start, take);
+        n += take;
+        reader->pos += take;
+        if (found != NULL)
+            break;
+    }
+    if (n == 0)
+        return -1;
+    (*line)[n] = '\0';
+    return (int) n;
+}
+
+/**
+ * Read a field up to one of the delimiters, which is consumed but not
+ * stored, and NUL-terminate it. A NULL *field is allocated with *capacity
+ * bytes: give the capacity of the last field to size the next one right.
+ * Its length is stored in *n. Return the delimiter, or EOF if the input
+ * ended first.
+ */
+int reader_getfield(reader_t *reader, char **field, size_t *capacity, size_t *n,
+                    const char *delimiters) {
+    if (*field == NULL) {
+        *capacity = *capacity > MIN_CHUNK ? *capacity : MIN_CHUNK;
+        *field = malloc_or_die(*capacity);
+    }
+    size_t len = 0;
+    int delimiter = EOF;
+    for (;;) {
+        if (reader->pos == reader->end && *capacity - len - 1 >= READER_BLOCK) {
+            /* Nothing buffered and room enough: read straight into the
+             * field, and give the block whatever follows it */
+            char *start = *field + len;
+            size_t got = reader_read(reader, start, READER_BLOCK);
+            if (got == 0)
+                break;
+            size_t span = reader_span(start, got, delimiters);
+            len += span;
+            if (span < got) {
+                delimiter = (unsigned char) start[span];
+                reader->pos = 0;
+                reader->end = got - span - 1;
+                memcpy(reader->block, start + span + 1, reader->end);
+                break;
+            }
+        } else {
+            if (!reader_fill(reader))
+                break;
+            char *start = reader->block + reader->pos;
+            size_t avail = reader->end - reader->pos;
+            size_t span = reader_span(start, avail, delimiters);
+            reader_reserve(field, capacity, len + span + 1);
+            memcpy(*field + len, start, span);
+            len += span;
+            reader->pos += span;
+            if (span < avail) {
+                delimiter = (unsigned char) start[span];
+                reader->pos++;
+                break;
+            }
+        }
+    }
+    (*field)[len] = '\0';
+    *n = len;
+    return delimiter;
+}
+
+/**
+ * Drop the input up to the next newline, included
+ */
+void reader_skipline(reader_t *reader) {
+    while (reader_fill(reader)) {
+        char *start = reader->block + reader->pos;
+        char *found = memchr(start, '\n', reader->end - reader->pos);
+        if (found != NULL) {
+            reader->pos += (size_t) (found - start) + 1;
+            return;
+        }
+        reader->pos = reader->end;
+    }
+}
@@ -0,0 +1,47 @@
+/*
+ * Copyright 2017 Francesco Circhetta
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef API_READER_H
+#define API_READER_H
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+#include <stddef.h>
+
+/****************************************************************************
+ * Public Types
+ ****************************************************************************/
+/* Buffered input of a file descriptor, read by lines or by fields */
+typedef struct _reader {
+    int                 fd;
+    char                *block;         /* Read ahead */
+    size_t              pos;            /* Next unread byte of block */
+    size_t              end;            /* End of the bytes read */
+} reader_t;
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+void reader_init(reader_t *, int);
+void reader_free(reader_t *);
+int reader_peek(reader_t *);
+int reader_getline(reader_t *, char **, size_t *, size_t, char);
+int reader_getfield(reader_t *, char **, size_t *, size_t *, const char *);
+void reader_skipline(reader_t *);
+
+#endif //API_READER_H
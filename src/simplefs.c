@@ -17,9 +17,823 @@
 /****************************************************************************
  * Included Files
  ****************************************************************************/
+#define _POSIX_C_SOURCE 200809L /* clock_gettime() */
+#include <stddef.h>
 #include <string.h>
+#include <time.h>
 
+#include "hash.h"
 #include "simplefs.h"
+#include "dirtable.h"
+#include "pool.h"
+#include "intern.h"
+#include "content.h"
+#include "spill.h"
+#include "lz.h"
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+/* A promoted directory shrinking to this size goes back to a dir_small_t */
+#define SMALL_DIR_DEMOTE (SMALL_DIR_NODES / 2)
+
+/* Nodes allocated at once when the pool runs out, 64 KB worth */
+#define NODE_CHUNK (65536 / sizeof(node_t))
+
+/* Names too long for their node are rounded up to a multiple of NAME_CLASS
+ * bytes, and every size has a pool of its own */
+#define NAME_CLASS 16
+#define NAME_CLASSES (MAX_NAMELENGHT / NAME_CLASS + 1)
+#define NAME_CHUNK_BYTES 16384
+
+/* Offset of a resident content with no copy in the spill file */
+#define SPILL_NONE UINT64_MAX
+
+/****************************************************************************
+ * Private Types
+ ****************************************************************************/
+#ifdef HT_KEYLESS
+/* Keyless directory tables find the key of a child through its name field */
+typedef char node_name_is_hashtable_key[offsetof(node_t, name) == HT_KEY_OFFSET ? 1 : -1];
+#endif
+#ifdef FS_DIR_ART
+/* So do directory trees */
+typedef char node_name_is_art_key[offsetof(node_t, name) == ART_KEY_OFFSET ? 1 : -1];
+#endif
+
+#ifdef FS_COMPRESS_CONTENTS
+/* Decompressed content of a file read recently */
+typedef struct _decoded {
+    node_t              *node;          /* NULL if unused */
+    char                *data;
+    size_t              capacity;
+    uint64_t            used;           /* decode_clock of the last read */
+} decoded_t;
+#endif
+
+#ifdef FS_SPILL_CONTENTS
+/* Resident content in the eviction clock */
+typedef struct _spill_slot {
+    node_t              *node;          /* NULL if free */
+    uint64_t            offset;         /* Of its copy in the spill file, or
+                                         * SPILL_NONE; next free slot if free */
+    bool                referenced;     /* Read since the hand last passed */
+} spill_slot_t;
+#endif
+
+/* Results of fs_find_r() so far */
+typedef struct _find_state {
+    char                *name;
+    size_t              *num;
+    node_t              **array;
+} find_state_t;
+
+/****************************************************************************
+ * Private Data
+ ****************************************************************************/
+/* Nodes of every tree, and their long names (the name arena). All of them
+ * are released once the last node is gone. */
+static pool_t nodes;
+#ifndef FS_INTERN_NAMES
+static pool_t names[NAME_CLASSES];
+#endif
+static bool nodes_ready = false;
+
+#ifdef FS_COMPRESS_CONTENTS
+/* Contents decompressed by the last reads, the least recently read one
+ * replaced on a miss */
+static decoded_t decoded[FS_DECODE_CACHE];
+static uint64_t decode_clock = 0;
+static fs_compress_stats_t compress_stats;
+#endif
+
+#ifdef FS_SPILL_CONTENTS
+/* Resident contents, swept by the hand of a clock to stay within the
+ * budget: one read since the hand last passed gets another round, the
+ * others are evicted. Slots up to spill_used have been taken, the free ones
+ * are chained by their offset. */
+static spill_slot_t *spill_slots = NULL;
+static size_t spill_capacity = 0;
+static size_t spill_used = 0;
+static size_t spill_free = SIZE_MAX;
+static size_t spill_hand = 0;
+/* Contents with a copy in the spill file, resident or not */
+static size_t spill_records = 0;
+static fs_spill_stats_t spill_stats = { .budget = FS_SPILL_BUDGET };
+#endif
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+static pool_t *node_pool(void) {
+    if (!nodes_ready) {
+        pool_init(&nodes, sizeof(node_t), NODE_CHUNK);
+#ifndef FS_INTERN_NAMES
+        for (size_t i = 0; i < NAME_CLASSES; i++) {
+            size_t size = (i + 1) * NAME_CLASS;
+            pool_init(&names[i], size, NAME_CHUNK_BYTES / size);
+        }
+#endif
+        nodes_ready = true;
+    }
+    return &nodes;
+}
+
+/**
+ * Allocate a node with a copy of the given name, of the given length
+ */
+static node_t *node_alloc(const char *name, size_t len) {
+    node_t *node = pool_alloc(node_pool());
+#ifdef FS_INTERN_NAMES
+    node->name = (char *) intern_acquire(name, len);
+#else
+    node->name = len < FS_INLINE_NAME ? node->inline_name : pool_alloc(&names[len / NAME_CLASS]);
+    memcpy(node->name, name, len + 1);
+#endif
+    node->name_len = (uint8_t) len;
+    return node;
+}
+
+static void node_free(node_t *node) {
+#ifdef FS_INTERN_NAMES
+    intern_release(node->name);
+#else
+    if (node->name != node->inline_name)
+        pool_free(&names[node->name_len / NAME_CLASS], node->name);
+#endif
+    pool_free(&nodes, node);
+    if (nodes.used == 0) {
+        pool_release(&nodes);
+#ifdef FS_COMPRESS_CONTENTS
+        for (size_t i = 0; i < FS_DECODE_CACHE; i++) {
+            free(decoded[i].data);
+            decoded[i].data = NULL;
+            decoded[i].capacity = 0;
+        }
+#endif
+#ifdef FS_SPILL_CONTENTS
+        free(spill_slots);
+        spill_slots = NULL;
+        spill_capacity = spill_used = spill_hand = 0;
+        spill_free = SIZE_MAX;
+#endif
+#ifndef FS_INTERN_NAMES
+        for (size_t i = 0; i < NAME_CLASSES; i++)
+            pool_release(&names[i]);
+#endif
+    }
+}
+
+#ifdef FS_COMPRESS_CONTENTS
+/**
+ * Forget the decompressed content of a file, which changes or goes away
+ */
+static void decoded_forget(node_t *node) {
+    for (size_t i = 0; i < FS_DECODE_CACHE; i++) {
+        if (decoded[i].node == node) {
+            decoded[i].node = NULL;
+            decoded[i].used = 0;
+            return;
+        }
+    }
+}
+
+/**
+ * Decompressed content of a file, from the cache or decoded into it
+ */
+static char *decoded_get(node_t *node) {
+    file_buffer_t *buffer = &node->payload.buffer;
+    decoded_t *victim = &decoded[0];
+    compress_stats.reads++;
+    decode_clock++;
+    for (size_t i = 0; i < FS_DECODE_CACHE; i++) {
+        if (decoded[i].node == node) {
+            decoded[i].used = decode_clock;
+            return decoded[i].data;
+        }
+        if (decoded[i].used < victim->used)
+            victim = &decoded[i];
+    }
+    /* Keep the buffer unless it is too small, or twice too large */
+    size_t size = (size_t) buffer->len + 1;
+    if (victim->capacity < size || victim->capacity / 2 > size) {
+        free(victim->data);
+        victim->data = malloc_or_die(size);
+        victim->capacity = size;
+    }
+    struct timespec start, stop;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    /* Blocks come from lz_compress(): failing means memory corruption */
+    if (!lz_decompress(buffer->data, buffer->capacity, victim->data, buffer->len))
+        exit(-1);
+    clock_gettime(CLOCK_MONOTONIC, &stop);
+    victim->data[buffer->len] = '\0';
+    victim->node = node;
+    victim->used = decode_clock;
+    compress_stats.decodes++;
+    compress_stats.decode_seconds += (double) (stop.tv_sec - start.tv_sec)
+                                     + (double) (stop.tv_nsec - start.tv_nsec) * 1e-9;
+    return victim->data;
+}
+#endif
+
+#ifdef FS_SPILL_CONTENTS
+/**
+ * Whether a file content counts against the budget, and may be evicted
+ */
+static bool spillable(node_t *node) {
+    return node->inline_len == FS_CONTENT_BUFFER && node->payload.buffer.capacity >= FS_SPILL_MIN;
+}
+
+/**
+ * Put a resident content in the clock, with the offset of its copy in the
+ * spill file if it has one
+ */
+static void spill_track(node_t *node, uint64_t offset) {
+    size_t i;
+    if (spill_free != SIZE_MAX) {
+        i = spill_free;
+        spill_free = (size_t) spill_slots[i].offset;
+    } else {
+        if (spill_used == spill_capacity) {
+            spill_capacity = spill_capacity ? spill_capacity * 2 : 64;
+            spill_slots = realloc_or_die(spill_slots, spill_capacity * sizeof(spill_slot_t));
+        }
+        i = spill_used++;
+    }
+    spill_slots[i].node = node;
+    spill_slots[i].offset = offset;
+    spill_slots[i].referenced = true;
+    node->spill_slot = (uint32_t) i;
+    spill_stats.resident_files++;
+    spill_stats.resident_bytes += node->payload.buffer.capacity;
+}
+
+/**
+ * Take a resident content out of the clock, return the offset of its copy
+ */
+static uint64_t spill_untrack(node_t *node) {
+    spill_slot_t *slot = &spill_slots[node->spill_slot];
+    uint64_t offset = slot->offset;
+    slot->node = NULL;
+    slot->offset = spill_free;
+    spill_free = node->spill_slot;
+    spill_stats.resident_files--;
+    spill_stats.resident_bytes -= node->payload.buffer.capacity;
+    return offset;
+}
+
+/**
+ * Drop a copy in the spill file, and every record with the last one
+ */
+static void spill_forget(uint64_t offset) {
+    if (offset != SPILL_NONE && --spill_records == 0)
+        spill_reset();
+}
+
+/**
+ * Move a resident content to the spill file, unless it has a copy there
+ * already. Return false if it cannot be written.
+ */
+static bool spill_evict(node_t *node) {
+    file_buffer_t *buffer = &node->payload.buffer;
+    uint32_t len = buffer->len;
+    uint64_t offset = spill_slots[node->spill_slot].offset;
+    if (offset == SPILL_NONE) {
+        if (!spill_append(buffer->data, len, &offset))
+            return false;
+        spill_records++;
+    }
+    spill_untrack(node);
+    free(buffer->data);
+    node->payload.spilled.offset = offset;
+    node->payload.spilled.len = len;
+    node->inline_len = FS_CONTENT_SPILLED;
+    spill_stats.spilled_files++;
+    spill_stats.spilled_bytes += len;
+    spill_stats.evictions++;
+    spill_stats.evicted_bytes += len;
+    return true;
+}
+
+/**
+ * Evict contents until the resident ones fit in the budget, all but keep.
+ * Those read since the hand last passed lose their mark instead. Stop if
+ * the spill file cannot be written.
+ */
+static void spill_enforce(node_t *keep) {
+    size_t idle = 0;
+    while (spill_stats.resident_bytes > spill_stats.budget && idle < 2 * spill_used) {
+        if (spill_hand >= spill_used)
+            spill_hand = 0;
+        spill_slot_t *slot = &spill_slots[spill_hand++];
+        if (slot->node == NULL || slot->node == keep) {
+            idle++;
+        } else if (slot->referenced) {
+            slot->referenced = false;
+            idle++;
+        } else {
+            if (!spill_evict(slot->node))
+                return;
+            idle = 0;
+        }
+    }
+}
+
+/**
+ * Read an evicted content back, and make room for it
+ */
+static char *spill_load(node_t *node) {
+    file_spilled_t spilled = node->payload.spilled;
+    file_buffer_t *buffer = &node->payload.buffer;
+    spill_stats.spilled_files--;
+    spill_stats.spilled_bytes -= spilled.len;
+    spill_stats.misses++;
+    /* Spilled contents were in a buffer, so no longer than FS_CONTENT_MAX */
+    buffer->capacity = (uint32_t) FILE_BUFFER_SIZE(spilled.len);
+    buffer->data = malloc_or_die(buffer->capacity);
+    spill_read(spilled.offset, buffer->data, spilled.len);
+    buffer->data[spilled.len] = '\0';
+    buffer->len = spilled.len;
+    node->inline_len = FS_CONTENT_BUFFER;
+    /* Rewritten in place, it may have shrunk below FS_SPILL_MIN */
+    if (spillable(node)) {
+        spill_track(node, spilled.offset);
+        spill_enforce(node);
+    } else {
+        spill_forget(spilled.offset);
+    }
+    return buffer->data;
+}
+
+/**
+ * Account for a new resident content, and make room for it
+ */
+static void spill_add(node_t *node) {
+    if (spillable(node)) {
+        spill_track(node, SPILL_NONE);
+        spill_enforce(NULL);
+    }
+}
+#endif
+
+/**
+ * Free the content of a file, or drop its reference to a shared one
+ */
+static void file_content_drop(node_t *node) {
+    if (node->inline_len == FS_CONTENT_BUFFER) {
+#ifdef FS_SPILL_CONTENTS
+        if (spillable(node))
+            spill_forget(spill_untrack(node));
+#endif
+        free(node->payload.buffer.data);
+    }
+#ifdef FS_SPILL_CONTENTS
+    else if (node->inline_len == FS_CONTENT_SPILLED) {
+        spill_stats.spilled_files--;
+        spill_stats.spilled_bytes -= node->payload.spilled.len;
+        spill_forget(node->payload.spilled.offset);
+    }
+#endif
+#ifdef FS_DEDUP_CONTENTS
+    else if (node->inline_len == FS_CONTENT_SHARED)
+        content_release(node->payload.buffer.data);
+#endif
+#ifdef FS_COMPRESS_CONTENTS
+    else if (node->inline_len == FS_CONTENT_COMPRESSED) {
+        decoded_forget(node);
+        compress_stats.files--;
+        compress_stats.bytes -= node->payload.buffer.len;
+        compress_stats.compressed_bytes -= node->payload.buffer.capacity;
+        free(node->payload.buffer.data);
+    }
+#endif
+}
+
+#ifdef FS_COMPRESS_CONTENTS
+/**
+ * Store a content of len bytes compressed if that saves an eighth of it.
+ * Return false if it does not, the file left as it was.
+ */
+static bool file_content_compress(node_t *node, const char *content, size_t len) {
+    size_t limit = len - len / 8;
+    char *packed = malloc_or_die(limit);
+    size_t size = len <= UINT32_MAX ? lz_compress(content, len, packed, limit) : 0;
+    if (size == 0) {
+        free(packed);
+        compress_stats.rejected++;
+        return false;
+    }
+    file_content_drop(node);
+    node->payload.buffer.data = realloc_or_die(packed, size);
+    node->payload.buffer.len = (uint32_t) len;
+    node->payload.buffer.capacity = (uint32_t) size;
+    node->inline_len = FS_CONTENT_COMPRESSED;
+    compress_stats.files++;
+    compress_stats.bytes += len;
+    compress_stats.compressed_bytes += size;
+    return true;
+}
+#endif
+
+#ifdef FS_DIR_GLOBAL
+/**
+ * Number of children of a directory
+ */
+static inline size_t dir_size(node_t *dir) {
+    return dir->children;
+}
+
+/**
+ * Get a child by name, or NULL
+ */
+static node_t *dir_get(node_t *dir, char *key) {
+    return dirtable_get(dir, key);
+}
+
+/**
+ * Add a child, whose parent is set already; return false if the name is
+ * already taken
+ */
+static bool dir_add(node_t *dir, node_t *child) {
+    if (!dirtable_add(child))
+        return false;
+    child->prev = NULL;
+    child->next = dir->payload.first;
+    if (child->next != NULL)
+        child->next->prev = child;
+    dir->payload.first = child;
+    dir->children++;
+    return true;
+}
+
+/**
+ * Remove a child
+ */
+static void dir_remove(node_t *dir, node_t *child) {
+    dirtable_remove(child);
+    if (child->prev != NULL)
+        child->prev->next = child->next;
+    else
+        dir->payload.first = child->next;
+    if (child->next != NULL)
+        child->next->prev = child->prev;
+    dir->children--;
+}
+
+/**
+ * Iterate through the children (the state holds the last child returned,
+ * which must not be removed in the meantime)
+ * Return NULL if no other child is present
+ */
+static node_t *dir_iterate(node_t *dir, size_t *state) {
+    node_t *child = *state ? ((node_t *) *state)->next : dir->payload.first;
+    *state = (size_t) child;
+    return child;
+}
+
+/**
+ * Call fn(child, arg) on every child.
+ * fn must not add or remove children of the directory.
+ */
+static void dir_walk(node_t *dir, void (*fn)(void *, void *), void *arg) {
+    for (node_t *child = dir->payload.first; child != NULL; child = child->next)
+        fn(child, arg);
+}
+
+/**
+ * Release the children container of a directory: there is none
+ */
+static void dir_destroy(node_t *dir) {
+    (void) dir;
+}
+#else
+/**
+ * One byte hash tag of a name, to skip most string compares in small dirs
+ */
+static inline uint8_t dir_tag(const char *name, size_t len) {
+#ifdef FS_INTERN_NAMES
+    (void) len;
+    return (uint8_t) intern_hash(name);
+#else
+    return (uint8_t) hash_string(name, len);
+#endif
+}
+
+/**
+ * Number of children of a directory
+ */
+static inline size_t dir_size(node_t *dir) {
+#ifdef FS_DIR_ART
+    if (dir->hashed)
+        return art_get_size(dir->payload.dirtree);
+#else
+    if (dir->hashed)
+        return hashtable_get_size(dir->payload.dirhash);
+#endif
+    return dir->payload.dirsmall ? dir->payload.dirsmall->count : 0;
+}
+
+/**
+ * Index of the named child of a small directory, or -1
+ */
+static int dir_small_find(dir_small_t *small, char *key, size_t len, uint8_t tag) {
+#ifdef FS_INTERN_NAMES
+    /* Interned names are equal if and only if they are the same */
+    (void) len;
+    (void) tag;
+    for (int i = 0; i < small->count; i++) {
+        if (small->child[i]->name == key)
+            return i;
+    }
+#else
+    for (int i = 0; i < small->count; i++) {
+        node_t *child = small->child[i];
+        if (small->tags[i] == tag && child->name_len == len && memcmp(child->name, key, len) == 0)
+            return i;
+    }
+#endif
+    return -1;
+}
+
+/**
+ * Get a child by name, or NULL
+ */
+static node_t *dir_get(node_t *dir, char *key) {
+#ifdef FS_DIR_ART
+    if (dir->hashed)
+        return art_get(dir->payload.dirtree, key);
+#else
+    if (dir->hashed)
+        return hashtable_get(dir->payload.dirhash, key);
+#endif
+    dir_small_t *small = dir->payload.dirsmall;
+    if (small == NULL)
+        return NULL;
+    size_t len = strlen(key);
+    int idx = dir_small_find(small, key, len, dir_tag(key, len));
+    return idx < 0 ? NULL : small->child[idx];
+}
+
+#ifdef FS_DIR_ART
+/**
+ * Move the children of a full small directory to a radix tree
+ */
+static void dir_promote(node_t *dir) {
+    dir_small_t *small = dir->payload.dirsmall;
+    art_tree_t *tree = art_create();
+    for (int i = 0; i < small->count; i++)
+        art_insert(tree, small->child[i]);
+    free(small);
+    dir->payload.dirtree = tree;
+    dir->hashed = true;
+}
+
+/**
+ * Move the children of a shrunk directory back to a dir_small_t, in order
+ */
+static void dir_demote(node_t *dir) {
+    art_tree_t *tree = dir->payload.dirtree;
+    dir_small_t *small = NULL;
+    if (art_get_size(tree) > 0) {
+        size_t state = 0;
+        node_t *child;
+        small = malloc_or_die(sizeof(dir_small_t));
+        small->count = 0;
+        while ((child = art_iterate(tree, &state)) != NULL) {
+            small->tags[small->count] = dir_tag(child->name, child->name_len);
+            small->child[small->count++] = child;
+        }
+    }
+    art_destroy(tree);
+    dir->payload.dirsmall = small;
+    dir->hashed = false;
+}
+#else
+/**
+ * Move the children of a full small directory to a hashtable
+ */
+static void dir_promote(node_t *dir) {
+    dir_small_t *small = dir->payload.dirsmall;
+    hashtable_t *table = hashtable_create();
+    for (int i = 0; i < small->count; i++)
+        hashtable_set(table, small->child[i]->name, small->child[i]);
+    free(small);
+    dir->payload.dirhash = table;
+    dir->hashed = true;
+}
+
+/**
+ * Move the children of a shrunk directory back to a dir_small_t
+ */
+static void dir_demote(node_t *dir) {
+    hashtable_t *table = dir->payload.dirhash;
+    dir_small_t *small = NULL;
+    if (hashtable_get_size(table) > 0) {
+        size_t state = 0;
+        node_t *child;
+        small = malloc_or_die(sizeof(dir_small_t));
+        small->count = 0;
+        while ((child = hashtable_iterate(table, &state)) != NULL) {
+            small->tags[small->count] = dir_tag(child->name, child->name_len);
+            small->child[small->count++] = child;
+        }
+    }
+    hashtable_destroy(table);
+    dir->payload.dirsmall = small;
+    dir->hashed = false;
+}
+#endif
+
+/**
+ * Add a child; return false if the name is already taken
+ */
+static bool dir_add(node_t *dir, node_t *child) {
+    if (!dir->hashed) {
+        dir_small_t *small = dir->payload.dirsmall;
+        uint8_t tag = dir_tag(child->name, child->name_len);
+        if (small == NULL) {
+            small = dir->payload.dirsmall = malloc_or_die(sizeof(dir_small_t));
+            small->count = 0;
+        } else if (dir_small_find(small, child->name, child->name_len, tag) >= 0) {
+            return false;
+        }
+        if (small->count < SMALL_DIR_NODES) {
+            int i = small->count;
+#ifdef FS_DIR_ART
+            /* Keep small directories sorted too */
+            for (; i > 0 && strcmp(small->child[i - 1]->name, child->name) > 0; i--) {
+                small->tags[i] = small->tags[i - 1];
+                small->child[i] = small->child[i - 1];
+            }
+#endif
+            small->tags[i] = tag;
+            small->child[i] = child;
+            small->count++;
+            return true;
+        }
+        dir_promote(dir);
+    }
+#ifdef FS_DIR_ART
+    return art_insert(dir->payload.dirtree, child);
+#else
+    return hashtable_set(dir->payload.dirhash, child->name, child);
+#endif
+}
+
+/**
+ * Remove a child
+ */
+static void dir_remove(node_t *dir, node_t *child) {
+    if (dir->hashed) {
+#ifdef FS_DIR_ART
+        art_remove(dir->payload.dirtree, child->name);
+#else
+        hashtable_remove(dir->payload.dirhash, child->name);
+#endif
+        if (dir_size(dir) <= SMALL_DIR_DEMOTE)
+            dir_demote(dir);
+        return;
+    }
+    dir_small_t *small = dir->payload.dirsmall;
+    for (int i = 0; i < small->count; i++) {
+        if (small->child[i] == child) {
+            small->count--;
+#ifdef FS_DIR_ART
+            /* Close the hole, keeping the order */
+            memmove(small->tags + i, small->tags + i + 1, small->count - i);
+            memmove(small->child + i, small->child + i + 1,
+                    (small->count - i) * sizeof(node_t *));
+#else
+            /* Fill the hole with the last child */
+            small->tags[i] = small->tags[small->count];
+            small->child[i] = small->child[small->count];
+#endif
+            break;
+        }
+    }
+    if (small->count == 0) {
+        free(small);
+        dir->payload.dirsmall = NULL;
+    }
+}
+
+#ifdef FS_DIR_ART
+/**
+ * Iterate through the children in name order (the state holds the last
+ * child returned, so it survives promotions and demotions, but that child
+ * must not be removed in the meantime)
+ * Return NULL if no other child is present
+ */
+static node_t *dir_iterate(node_t *dir, size_t *state) {
+    if (dir->hashed)
+        return art_iterate(dir->payload.dirtree, state);
+    dir_small_t *small = dir->payload.dirsmall;
+    if (small == NULL)
+        return NULL;
+    node_t *last = (node_t *) *state;
+    for (int i = 0; i < small->count; i++) {
+        if (last == NULL || strcmp(small->child[i]->name, last->name) > 0) {
+            *state = (size_t) small->child[i];
+            return small->child[i];
+        }
+    }
+    return NULL;
+}
+#else
+/**
+ * Iterate through the children (uses only an int as state memory)
+ * Return NULL if no other child is present
+ */
+static node_t *dir_iterate(node_t *dir, size_t *state) {
+    if (dir->hashed)
+        return hashtable_iterate(dir->payload.dirhash, state);
+    dir_small_t *small = dir->payload.dirsmall;
+    if (small == NULL || *state >= small->count)
+        return NULL;
+    return small->child[(*state)++];
+}
+#endif
+
+/**
+ * Call fn(child, arg) on every child, in name order with FS_DIR_ART.
+ * fn must not add or remove children of the directory.
+ */
+static void dir_walk(node_t *dir, void (*fn)(void *, void *), void *arg) {
+    if (dir->hashed) {
+#ifdef FS_DIR_ART
+        art_walk(dir->payload.dirtree, fn, arg);
+#else
+        size_t state = 0;
+        node_t *child;
+        while ((child = hashtable_iterate(dir->payload.dirhash, &state)) != NULL)
+            fn(child, arg);
+#endif
+        return;
+    }
+    dir_small_t *small = dir->payload.dirsmall;
+    for (int i = 0; small != NULL && i < small->count; i++)
+        fn(small->child[i], arg);
+}
+
+/**
+ * Release the children container of a directory
+ */
+static void dir_destroy(node_t *dir) {
+#ifdef FS_DIR_ART
+    if (dir->hashed)
+        art_destroy(dir->payload.dirtree);
+#else
+    if (dir->hashed)
+        hashtable_destroy(dir->payload.dirhash);
+#endif
+    else
+        free(dir->payload.dirsmall);
+}
+#endif
+
+/**
+ * Check a child during a find, and its subtree if it is a directory
+ */
+static void fs_find_child(void *value, void *arg) {
+    node_t *child = value;
+    find_state_t *find = arg;
+#ifdef FS_INTERN_NAMES
+    if (child->name == find->name) {
+#else
+    if (strcmp(child->name, find->name) == 0) {
+#endif
+        /* We found a node with the requested name */
+        *find->num = *find->num + 1;
+        find->array = (find->array == NULL)
+                      ? malloc_or_die(sizeof(node_t *))
+                      : realloc_or_die(find->array, (*find->num) * sizeof(node_t *));
+        find->array[*find->num - 1] = child;
+    }
+    /* Check subdirs */
+    if (child->type == Dir) {
+        dir_walk(child, fs_find_child, find);
+    }
+}
+
+/**
+ * Delete every child of a directory, recursively
+ */
+static void fs_delete_children(node_t *dir) {
+    /* Iterate through the children */
+    while (dir_size(dir) > 0) {
+        size_t state = 0;
+        node_t *child = dir_iterate(dir, &state);
+        while (child) {
+            fs_delete(child, true);
+#if defined(FS_DIR_ART) || defined(FS_DIR_GLOBAL)
+            /* The state was the child just deleted: restart */
+            state = 0;
+#endif
+            child = dir_iterate(dir, &state);
+        }
+    }
+}
 
 /****************************************************************************
  * Public Functions
@@ -31,7 +845,7 @@ char *fs_get_path(node_t *node, size_t len) {
     char *path;
     /* Root? Alloc path array */
     if (node->parent != NULL) {
-        path = fs_get_path(node->parent, len + strlen(node->name) + 1);
+        path = fs_get_path(node->parent, len + node->name_len + 1);
         strcat(path, "/");
         strcat(path, node->name);
     } else {
@@ -50,38 +864,202 @@ uint8_t fs_get_type(node_t *node) {
 }
 
 /**
- * Get file content
+ * Get file content. A compressed one is decompressed in a cache, and the
+ * pointer stays good until FS_DECODE_CACHE other ones are read. An evicted
+ * one is read back, and a resident one may be evicted by the next write or
+ * read of an evicted one.
  */
 char *fs_get_file_content(node_t *node) {
     if (node->type != File) {
         /* This isn't a file */
         return NULL;
     }
-    return node->payload.content;
+#ifdef FS_COMPRESS_CONTENTS
+    if (node->inline_len == FS_CONTENT_COMPRESSED)
+        return decoded_get(node);
+#endif
+#ifdef FS_SPILL_CONTENTS
+    if (node->inline_len == FS_CONTENT_SPILLED)
+        return spill_load(node);
+    if (spillable(node)) {
+        spill_stats.hits++;
+        spill_slots[node->spill_slot].referenced = true;
+    }
+#endif
+    if (node->inline_len >= FS_CONTENT_SHARED)
+        return node->payload.buffer.data;
+    return node->payload.inline_content;
+}
+
+/**
+ * Get the length of a file content, 0 if the node is not a file
+ */
+size_t fs_get_file_size(node_t *node) {
+    if (node->type != File)
+        return 0;
+#ifdef FS_SPILL_CONTENTS
+    if (node->inline_len == FS_CONTENT_SPILLED)
+        return node->payload.spilled.len;
+#endif
+    if (node->inline_len >= FS_CONTENT_COMPRESSED)
+        return node->payload.buffer.len;
+    return node->inline_len;
 }
 
 /**
  * Assign new content to a file
- * Return true if succeeded, false if failed
+ * Return true if succeeded, false if failed: the node is not a file, or the
+ * content is longer than FS_CONTENT_MAX
  */
 bool fs_set_file_content(node_t *node, char *new_content) {
     if (fs_get_type(node) != File) {
         /* This isn't a file */
         return false;
     }
-    /* Free the old content */
-    free(node->payload.content);
-    /* Duplicate the new content */
-    node->payload.content = my_strdup(new_content);
+    size_t len = strlen(new_content);
+    if (len > FS_CONTENT_MAX)
+        return false;
+    file_buffer_t *buffer = &node->payload.buffer;
+#ifdef FS_COMPRESS_CONTENTS
+    if (len >= FS_COMPRESS_MIN && file_content_compress(node, new_content, len))
+        return true;
+#endif
+#ifdef FS_DEDUP_CONTENTS
+    if (len >= FS_INLINE_CONTENT) {
+        /* Shared contents are never written: take the new one before
+         * dropping the old, which may well be the same */
+        const char *shared = content_acquire(new_content, len);
+        if (shared == NULL)
+            return false;
+        file_content_drop(node);
+        buffer->data = (char *) shared;
+        buffer->len = (uint32_t) len;
+        buffer->capacity = 0;
+        node->inline_len = FS_CONTENT_SHARED;
+        return true;
+    }
+    file_content_drop(node);
+#else
+    if (node->inline_len == FS_CONTENT_BUFFER) {
+        /* Overwrite in place if it fits, unless it would waste most of the
+         * buffer */
+        if (len >= FS_INLINE_CONTENT && len < buffer->capacity && len >= buffer->capacity / 4) {
+            memcpy(buffer->data, new_content, len + 1);
+            buffer->len = (uint32_t) len;
+#ifdef FS_SPILL_CONTENTS
+            if (spillable(node)) {
+                /* Its copy in the spill file is stale */
+                spill_forget(spill_slots[node->spill_slot].offset);
+                spill_slots[node->spill_slot].offset = SPILL_NONE;
+            }
+#endif
+            return true;
+        }
+    }
+    file_content_drop(node);
+#endif
+    if (len < FS_INLINE_CONTENT) {
+        memcpy(node->payload.inline_content, new_content, len + 1);
+        node->inline_len = (uint8_t) len;
+    } else {
+        /* Some room to grow: malloc rounds up to 16 bytes anyway */
+        buffer->capacity = (uint32_t) FILE_BUFFER_SIZE(len);
+        buffer->data = malloc_or_die(buffer->capacity);
+        memcpy(buffer->data, new_content, len + 1);
+        buffer->len = (uint32_t) len;
+        node->inline_len = FS_CONTENT_BUFFER;
+#ifdef FS_SPILL_CONTENTS
+        spill_add(node);
+#endif
+    }
     return true;
 }
 
+/**
+ * Give a file the content in data, a malloc()ed buffer of capacity bytes
+ * holding len bytes and a terminator, instead of copying it. The file owns
+ * data if this returns true; false if the node is not a file, or the
+ * content or its buffer are too large for a file_buffer_t. Adopted contents
+ * are not shared, even with FS_DEDUP_CONTENTS.
+ */
+bool fs_adopt_file_content(node_t *node, char *data, size_t len, size_t capacity) {
+    if (fs_get_type(node) != File || len > FS_CONTENT_MAX || capacity > UINT32_MAX)
+        return false;
+    if (len < FS_INLINE_CONTENT) {
+        fs_set_file_content(node, data);
+        free(data);
+        return true;
+    }
+#ifdef FS_COMPRESS_CONTENTS
+    if (len >= FS_COMPRESS_MIN && file_content_compress(node, data, len)) {
+        free(data);
+        return true;
+    }
+#endif
+    file_content_drop(node);
+    /* A buffer sized for reading may be far too large: give back the rest,
+     * which realloc() does in place */
+    if (capacity - len > len / 4) {
+        capacity = len + 1;
+        data = realloc_or_die(data, capacity);
+    }
+    node->payload.buffer.data = data;
+    node->payload.buffer.len = (uint32_t) len;
+    node->payload.buffer.capacity = (uint32_t) capacity;
+    node->inline_len = FS_CONTENT_BUFFER;
+#ifdef FS_SPILL_CONTENTS
+    spill_add(node);
+#endif
+    return true;
+}
+
+/**
+ * Take the buffer of a file content out of the file, which is left empty,
+ * and store its capacity. Return NULL if the node is not a file or if its
+ * content is not in a buffer of its own.
+ */
+char *fs_take_file_content(node_t *node, size_t *capacity) {
+    if (fs_get_type(node) != File || node->inline_len != FS_CONTENT_BUFFER)
+        return NULL;
+#ifdef FS_SPILL_CONTENTS
+    if (spillable(node))
+        spill_forget(spill_untrack(node));
+#endif
+    char *data = node->payload.buffer.data;
+    *capacity = node->payload.buffer.capacity;
+    node->payload.inline_content[0] = '\0';
+    node->inline_len = 0;
+    return data;
+}
+
+/**
+ * Name to look nodes up by, for fs_find_name(): with FS_INTERN_NAMES its
+ * interned copy, or NULL if no node has that name, else the name itself
+ */
+char *fs_lookup_name(char *name) {
+#ifdef FS_INTERN_NAMES
+    /* Directories hold interned names, and a name never interned is not in
+     * any of them */
+    return (char *) intern_get(name);
+#else
+    return name;
+#endif
+}
+
+/**
+ * Get a node by a name from fs_lookup_name() from a specific directory,
+ * return NULL if not found. A walk down a path looks every component up
+ * once, then pays no hashing nor comparing of its bytes per directory.
+ */
+node_t *fs_find_name(node_t *parent, char *name) {
+    return name != NULL ? dir_get(parent, name) : NULL;
+}
+
 /**
  * Get a node by name from a specific directory, return NULL if not found
  */
 node_t *fs_find_in_dir(node_t *parent, char *key) {
-    /* Get node from dir hashtable */
-    return hashtable_get(parent->payload.dirhash, key);
+    return fs_find_name(parent, fs_lookup_name(key));
 }
 
 /**
@@ -89,28 +1067,32 @@ node_t *fs_find_in_dir(node_t *parent, char *key) {
  * Return true if succeeded, false if failed
  */
 bool fs_create(node_t *parent, char *key, uint8_t type) {
-    if (hashtable_get_size(parent->payload.dirhash) >= MAX_NODES /* Dir is full */
-        || strlen(key) > MAX_NAMELENGHT /* Name is too long */
+    size_t len = strlen(key);
+    if (dir_size(parent) >= MAX_NODES /* Dir is full */
+        || len > MAX_NAMELENGHT /* Name is too long */
         || parent->depth >= MAX_DEPTH) /* Parent node is at max depth */
         return false;
     /* Create a new empty resource */
-    node_t *child = malloc_or_die(sizeof(node_t));
-    child->name = my_strdup(key);
-    if (hashtable_set(parent->payload.dirhash, child->name, child)) {
-        child->depth = parent->depth + (uint16_t)1;
-        child->parent = parent;
+    node_t *child = node_alloc(key, len);
+    child->parent = parent;
+    if (dir_add(parent, child)) {
+        child->depth = parent->depth + 1;
         child->type = type;
+        child->hashed = false;
+#ifdef FS_DIR_GLOBAL
+        child->children = 0;
+#endif
         if (type == Dir) {
-            // Empty DirHash
-            child->payload.dirhash = hashtable_create();
+            // Empty dir, children are allocated on first create
+            child->payload.dirsmall = NULL;
         } else {
-            // Empty content
-            child->payload.content = calloc_or_die(1, sizeof(char));
+            // Empty content, in the node
+            child->payload.inline_content[0] = '\0';
+            child->inline_len = 0;
         }
         return true;
     }
-    free(child->name);
-    free(child);
+    node_free(child);
     return false;
 }
 
@@ -120,71 +1102,93 @@ bool fs_create(node_t *parent, char *key, uint8_t type) {
 bool fs_delete(node_t *node, bool recursive) {
     /* If dir is not empty, delete every child */
     if (node->type == Dir) {
-        if(hashtable_get_size(node->payload.dirhash) > 0) {
+        if(dir_size(node) > 0) {
             /* Recursion disabled? Dir is not empty! */
             if (!recursive) return false;
-            /* Iterate through the table */
-            do {
-                size_t state = 0;
-                node_t *child = hashtable_iterate(node->payload.dirhash, &state);
-                while (child) {
-                    fs_delete(child, true);
-                    child = hashtable_iterate(node->payload.dirhash, &state);
-                }
-            } while (hashtable_get_size(node->payload.dirhash) > 0);
-        }
-        hashtable_destroy(node->payload.dirhash);
+            fs_delete_children(node);
+        }
+        dir_destroy(node);
     } else {
-        free(node->payload.content);
+        file_content_drop(node);
     }
-    hashtable_remove(node->parent->payload.dirhash, node->name);
-    free(node->name);
-    free(node);
+    dir_remove(node->parent, node);
+    node_free(node);
     return true;
 }
 
+#ifdef FS_COMPRESS_CONTENTS
+/**
+ * Return the counters of compressed contents
+ */
+fs_compress_stats_t fs_get_compress_stats(void) {
+    return compress_stats;
+}
+#endif
+
+#ifdef FS_SPILL_CONTENTS
+/**
+ * Set the memory budget of file contents, and evict down to it
+ */
+void fs_set_spill_budget(size_t bytes) {
+    spill_stats.budget = bytes;
+    spill_enforce(NULL);
+}
+
+/**
+ * Return the counters of resident and evicted contents
+ */
+fs_spill_stats_t fs_get_spill_stats(void) {
+    fs_spill_stats_t stats = spill_stats;
+    stats.file_bytes = spill_get_size();
+    return stats;
+}
+#endif
+
 /**
  * Create a new root directory
  */
 node_t *fs_new_root(void) {
     node_t *root;
-    root = malloc_or_die(sizeof(node_t));
-    root->name = calloc_or_die(1, sizeof(char));
+    root = node_alloc("", 0);
     root->depth = 0;
     root->parent = NULL;
     root->type = Dir;
-    root->payload.dirhash = hashtable_create();
+    root->hashed = false;
+    root->payload.dirsmall = NULL;
+#ifdef FS_DIR_GLOBAL
+    root->children = 0;
+#endif
     return root;
 }
 
 /**
- * Destroy the root directory
+ * Destroy the root directory, and whatever is left in it
  */
 void fs_destroy_root(node_t *root) {
-    hashtable_destroy(root->payload.dirhash);
-    free(root->name);
-    free(root);
+    fs_delete_children(root);
+    dir_destroy(root);
+    node_free(root);
+}
+
+/**
+ * Make room for the given number of nodes at once, e.g. from a hint on the
+ * expected size of the tree. Return false if no allocation could hold them.
+ */
+bool fs_reserve_nodes(size_t count) {
+    return pool_reserve(node_pool(), count);
 }
 
 /**
  * Find resources recursively given a starting directory
+ * With FS_DIR_ART the results come in depth-first, name order: that is path
+ * order too, as long as names hold no character sorting before '/'.
  */
 node_t **fs_find_r(node_t *node, char *name, size_t *num, node_t **array) {
-    size_t state = 0; // Iterator state
-    node_t *child = hashtable_iterate(node->payload.dirhash, &state);
-    while (child) {
-        if (strcmp(child->name, name) == 0) {
-            /* We found a node with the requested name */
-            *num = *num + 1;
-            array = (array == NULL) ? malloc_or_die(sizeof(node_t *))
-                                    : realloc_or_die(array, (*num) * sizeof(node_t *));
-            array[*num - 1] = child;
-        }
-        /* Check subdirs */
-        if (child->type == Dir) {
-            array = fs_find_r(child, name, num, array);
-        }
-        child = hashtable_iterate(node->payload.dirhash, &state);
-    }
-    return array;
+    /* No node is named after a string never interned */
+    name = fs_lookup_name(name);
+    if (name == NULL)
+        return array;
+    find_state_t find = { name, num, array };
+    dir_walk(node, fs_find_child, &find);
+    return find.array;
 }
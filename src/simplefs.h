@@ -24,13 +24,62 @@
 #include <stdbool.h>
 #include "utils.h"
 #include "hashtable.h"
+#include "art.h"
 
 /****************************************************************************
  * Pre-processor Definitions
  ****************************************************************************/
+/* Children per directory and directory depth, overridable at build time */
+#ifndef MAX_NODES
 #define MAX_NODES 1024
+#endif
 #define MAX_NAMELENGHT 255
+#ifndef MAX_DEPTH
 #define MAX_DEPTH 255
+#endif
+#if defined(FS_DIR_ART) && defined(FS_DIR_GLOBAL)
+#error "FS_DIR_ART and FS_DIR_GLOBAL are exclusive"
+#endif
+/* Names shorter than this are stored in their node, longer ones in the
+ * name arena of simplefs.c. With FS_INTERN_NAMES all names are interned
+ * instead (see intern.h), and compare by pointer. */
+#ifndef FS_INLINE_NAME
+#define FS_INLINE_NAME 24
+#endif
+/* File contents shorter than this are stored in their node, longer ones in
+ * a file_buffer_t. Below 252, and no less than sizeof(file_buffer_t) which
+ * the node holds anyway. */
+#ifndef FS_INLINE_CONTENT
+#define FS_INLINE_CONTENT 16
+#endif
+/* inline_len of a file whose content is in a file_buffer_t: its own, or
+ * shared with other files through the content store (with
+ * FS_DEDUP_CONTENTS, see content.h) */
+#define FS_CONTENT_BUFFER UINT8_MAX
+#define FS_CONTENT_SHARED (UINT8_MAX - 1)
+/* With FS_COMPRESS_CONTENTS, contents from FS_COMPRESS_MIN bytes on are
+ * compressed (see lz.h) when that saves an eighth of them, and reads
+ * decompress them into a cache of the last FS_DECODE_CACHE ones */
+#define FS_CONTENT_COMPRESSED (UINT8_MAX - 2)
+#ifndef FS_COMPRESS_MIN
+#define FS_COMPRESS_MIN 4096
+#endif
+#ifndef FS_DECODE_CACHE
+#define FS_DECODE_CACHE 4
+#endif
+/* With FS_SPILL_CONTENTS, contents from FS_SPILL_MIN bytes on in buffers of
+ * their own count against a memory budget, FS_SPILL_BUDGET bytes unless
+ * set at run time. The ones not read lately are evicted to a spill file
+ * (see spill.h) to stay within it, and read back from there. */
+#define FS_CONTENT_SPILLED (UINT8_MAX - 3)
+#ifndef FS_SPILL_MIN
+#define FS_SPILL_MIN 1024
+#endif
+#ifndef FS_SPILL_BUDGET
+#define FS_SPILL_BUDGET ((size_t) 256 << 20)
+#endif
+/* Directories up to this size keep their children in a dir_small_t */
+#define SMALL_DIR_NODES 8
 
 /****************************************************************************
  * Public Types
@@ -41,32 +90,129 @@ enum {
     File,
 };
 
+struct _node;
+
+/* Children of a small directory, with one hash tag byte each */
+typedef struct _dir_small {
+    uint8_t             count;
+    uint8_t             tags[SMALL_DIR_NODES];
+    struct _node        *child[SMALL_DIR_NODES];
+} dir_small_t;
+
+/* Content of a file too long for its node. Rewrites that fit reuse it,
+ * unless it is shared. */
+typedef struct _file_buffer {
+    char                *data;
+    uint32_t            len;
+    uint32_t            capacity;       /* Of data, terminator included, 0 if
+                                         * shared, the size of compressed data */
+} file_buffer_t;
+
+/* Capacity of the buffer a file allocates for a copy of a content of len
+ * bytes: malloc rounds up to 16 anyway */
+#define FILE_BUFFER_SIZE(len) (((size_t) (len) + 16) & ~(size_t) 15)
+/* Longest content a file holds: FILE_BUFFER_SIZE() of it must fit the
+ * 32-bit capacity */
+#define FS_CONTENT_MAX (UINT32_MAX - 16)
+
+/* Content of a file evicted to the spill file */
+typedef struct _file_spilled {
+    uint64_t            offset;
+    uint32_t            len;
+} file_spilled_t;
+
+/* With FS_DIR_ART promoted directories keep their children in a radix tree
+ * instead of a hashtable, and every directory iterates in name order. With
+ * FS_DIR_GLOBAL all of them are indexed by one table (see dirtable.c) and
+ * only link their children. */
 typedef union {
-    hashtable_t         *dirhash;
-    char                *content;
+    dir_small_t         *dirsmall;      /* Small dir, NULL while empty */
+    hashtable_t         *dirhash;       /* Promoted dir (hashed flag) */
+    art_tree_t          *dirtree;       /* Same, with FS_DIR_ART */
+    struct _node        *first;         /* First child, with FS_DIR_GLOBAL */
+    file_buffer_t       buffer;         /* Long file content */
+    file_spilled_t      spilled;        /* Same, evicted */
+    char                inline_content[FS_INLINE_CONTENT];
 } node_data_u;
 
 /* FS tree node */
 typedef struct _node {
-    char                *name;
+    char                *name;          /* Interned, inline_name or arena */
     struct _node        *parent;
     node_data_u         payload;
     uint8_t             type;
-    uint16_t            depth;
+    bool                hashed;
+    uint8_t             name_len;
+    uint8_t             inline_len;     /* Of a file, or FS_CONTENT_* */
+    uint32_t            depth;
+#ifdef FS_DIR_GLOBAL
+    struct _node        *prev;          /* Siblings */
+    struct _node        *next;
+    uint32_t            children;       /* Of a directory */
+#endif
+#ifdef FS_SPILL_CONTENTS
+    uint32_t            spill_slot;     /* Of a file in the eviction clock */
+#endif
+#ifndef FS_INTERN_NAMES
+    char                inline_name[FS_INLINE_NAME];
+#endif
 } node_t;
 
+#ifdef FS_COMPRESS_CONTENTS
+/* Compressed contents, and their reads */
+typedef struct _fs_compress_stats {
+    size_t              files;          /* Holding a compressed content */
+    size_t              bytes;          /* Of their contents */
+    size_t              compressed_bytes;
+    size_t              rejected;       /* Contents that did not compress */
+    size_t              reads;          /* Of compressed contents */
+    size_t              decodes;        /* Reads the cache missed */
+    double              decode_seconds;
+} fs_compress_stats_t;
+#endif
+
+#ifdef FS_SPILL_CONTENTS
+/* Contents under the memory budget, and the spill file */
+typedef struct _fs_spill_stats {
+    size_t              budget;
+    size_t              resident_files; /* Holding a content in memory */
+    size_t              resident_bytes; /* Of their buffers */
+    size_t              spilled_files;  /* Holding one in the spill file */
+    size_t              spilled_bytes;
+    size_t              hits;           /* Reads of resident contents */
+    size_t              misses;         /* Reads from the spill file */
+    size_t              evictions;
+    size_t              evicted_bytes;  /* Including contents already in
+                                         * the file, not written again */
+    uint64_t            file_bytes;     /* Spill file size, garbage included */
+} fs_spill_stats_t;
+#endif
+
 /****************************************************************************
  * Public Functions
  ****************************************************************************/
 char *fs_get_path(node_t *, size_t);
 char *fs_get_file_content(node_t *);
+size_t fs_get_file_size(node_t *);
 uint8_t fs_get_type(node_t *);
 bool fs_set_file_content(node_t *, char *);
+bool fs_adopt_file_content(node_t *, char *, size_t, size_t);
+char *fs_take_file_content(node_t *, size_t *);
 bool fs_create(node_t *, char *, uint8_t);
 bool fs_delete(node_t *, bool);
 void fs_destroy_root(node_t *);
 node_t **fs_find_r(node_t *, char *, size_t *, node_t **);
 node_t *fs_find_in_dir(node_t *, char *);
+char *fs_lookup_name(char *);
+node_t *fs_find_name(node_t *, char *);
 node_t *fs_new_root(void);
+bool fs_reserve_nodes(size_t);
+#ifdef FS_COMPRESS_CONTENTS
+fs_compress_stats_t fs_get_compress_stats(void);
+#endif
+#ifdef FS_SPILL_CONTENTS
+void fs_set_spill_budget(size_t);
+fs_spill_stats_t fs_get_spill_stats(void);
+#endif
 
 #endif //API_SIMPLEFS_H
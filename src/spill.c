@@ -0,0 +1,124 @@
+/*
+ * Copyright 2017 Francesco Circhetta
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * Spill file of evicted file contents.
+ *
+ * Contents are appended and never rewritten: a file that changes gets a
+ * new record, and the old one is garbage until the file holds no record at
+ * all and is truncated. It is created in $TMPDIR (/tmp by default) on the
+ * first append, and unlinked at once so that it goes away with the
+ * process.
+ */
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+#define _POSIX_C_SOURCE 200809L /* mkstemp(), pread(), pwrite() */
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "utils.h"
+#include "spill.h"
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+#define SPILL_TEMPLATE "simplefs-spill-XXXXXX"
+
+/****************************************************************************
+ * Private Data
+ ****************************************************************************/
+static int spill_fd = -1;
+static uint64_t spill_end = 0;
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+/**
+ * Create the spill file. Return false if it cannot be.
+ */
+static bool spill_open(void) {
+    const char *dir = getenv("TMPDIR");
+    if (dir == NULL || *dir == '\0')
+        dir = "/tmp";
+    size_t len = strlen(dir);
+    char *path = malloc_or_die(len + sizeof(SPILL_TEMPLATE) + 1);
+    memcpy(path, dir, len);
+    path[len] = '/';
+    memcpy(path + len + 1, SPILL_TEMPLATE, sizeof(SPILL_TEMPLATE));
+    spill_fd = mkstemp(path);
+    if (spill_fd >= 0)
+        unlink(path);
+    free(path);
+    return spill_fd >= 0;
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+/**
+ * Append len bytes of data to the spill file, and store where they are.
+ * Return false if they could not be written, the disk full for instance.
+ */
+bool spill_append(const char *data, size_t len, uint64_t *offset) {
+    if (spill_fd < 0 && !spill_open())
+        return false;
+    size_t done = 0;
+    while (done < len) {
+        ssize_t wrote = pwrite(spill_fd, data + done, len - done, (off_t) (spill_end + done));
+        if (wrote < 0 && errno == EINTR)
+            continue;
+        if (wrote <= 0)
+            return false;
+        done += (size_t) wrote;
+    }
+    *offset = spill_end;
+    spill_end += len;
+    return true;
+}
+
+/**
+ * Read back len bytes appended at offset. The file cannot be used without
+ * them: crash if they cannot be read!
+ */
+void spill_read(uint64_t offset, char *data, size_t len) {
+    size_t done = 0;
+    while (done < len) {
+        ssize_t got = pread(spill_fd, data + done, len - done, (off_t) (offset + done));
+        if (got < 0 && errno == EINTR)
+            continue;
+        if (got <= 0)
+            exit(-1);
+        done += (size_t) got;
+    }
+}
+
+/**
+ * Drop every record, once none is used any more
+ */
+void spill_reset(void) {
+    if (spill_fd >= 0 && spill_end > 0 && ftruncate(spill_fd, 0) == 0)
+        spill_end = 0;
+}
+
+/**
+ * Return the size of the spill file, garbage included
+ */
+uint64_t spill_get_size(void) {
+    return spill_end;
+}
@@ -0,0 +1,166 @@
+#include "cheat.h"
+#include "cheats.h"
+#include "utils.h"
+#include "art.h"
+
+/* Trees read the key through the value, which must point to it: values are
+ * &keys[i] throughout */
+CHEAT_DECLARE(
+    art_tree_t *t;
+    char *keys[2000];
+    size_t count;
+
+    /* Keys with long shared prefixes, one- and two-byte suffixes and every
+     * byte value from '!' on, so that all node types and prefix splits get
+     * exercised */
+    void fill_keys(void) {
+        count = 0;
+        for (int i = 0; i < 1000; i++) {
+            keys[count] = malloc_or_die(32);
+            sprintf(keys[count++], "%s%d", i % 2 ? "a" : "a_very_long_shared_prefix_", i);
+        }
+        for (int c = '!'; c < 256; c++) {
+            for (int d = 0; d < 3; d++) {
+                keys[count] = malloc_or_die(4);
+                keys[count][0] = (char) c;
+                keys[count][1] = d ? (char) ('a' + d) : '\0';
+                keys[count][2] = '\0';
+                count++;
+            }
+        }
+    }
+
+    void free_keys(void) {
+        for (size_t i = 0; i < count; i++)
+            free(keys[i]);
+    }
+
+    int compare_key(const void *a, const void *b) {
+        return strcmp(*(char * const *) a, *(char * const *) b);
+    }
+
+    /* Walk callback checking the order, arg points to the previous value */
+    void check_order(void *value, void *arg) {
+        char ***last = arg;
+        cheat_assert(*last == NULL || strcmp(**last, *(char **) value) < 0);
+        *last = value;
+    }
+)
+
+CHEAT_SET_UP(
+    t = art_create();
+)
+
+CHEAT_TEAR_DOWN(
+    art_destroy(t);
+)
+
+CHEAT_TEST(test_art_insert,
+    char *key = "asdf";
+    cheat_assert(art_insert(t, &key));
+    cheat_assert_size(art_get_size(t), 1);
+    char *same = "asdf";
+    cheat_assert_not(art_insert(t, &same));
+    cheat_assert_size(art_get_size(t), 1);
+    cheat_assert_pointer(art_get(t, "asdf"), &key);
+    cheat_assert_pointer(art_get(t, "asd"), NULL);
+    cheat_assert_pointer(art_get(t, "asdfg"), NULL);
+)
+
+CHEAT_TEST(test_art_remove,
+    char *key = "asdf";
+    cheat_assert(art_insert(t, &key));
+    cheat_assert_pointer(art_remove(t, "asd"), NULL);
+    cheat_assert_pointer(art_remove(t, "asdf"), &key);
+    cheat_assert_size(art_get_size(t), 0);
+    cheat_assert_pointer(art_get(t, "asdf"), NULL);
+    cheat_assert_pointer(art_remove(t, "asdf"), NULL);
+)
+
+CHEAT_TEST(test_art_hammer,
+    fill_keys();
+    for (size_t i = 0; i < count; i++) {
+        cheat_assert(art_insert(t, &keys[i]));
+        cheat_assert_size(art_get_size(t), i + 1);
+    }
+    for (size_t i = 0; i < count; i++) {
+        cheat_assert_pointer(art_get(t, keys[i]), &keys[i]);
+    }
+    /* Remove half, then the rest, checking lookups on the way */
+    for (size_t i = 0; i < count; i += 2) {
+        cheat_assert_pointer(art_remove(t, keys[i]), &keys[i]);
+    }
+    for (size_t i = 0; i < count; i++) {
+        cheat_assert_pointer(art_get(t, keys[i]), i % 2 ? &keys[i] : NULL);
+    }
+    for (size_t i = 1; i < count; i += 2) {
+        cheat_assert_pointer(art_remove(t, keys[i]), &keys[i]);
+    }
+    cheat_assert_size(art_get_size(t), 0);
+    cheat_assert_pointer(t->root, NULL);
+    free_keys();
+)
+
+CHEAT_TEST(test_art_iterate,
+    /* Values come in strcmp order */
+    fill_keys();
+    for (size_t i = 0; i < count; i++) {
+        cheat_assert(art_insert(t, &keys[i]));
+    }
+    for (size_t i = 0; i < count; i += 3) {
+        art_remove(t, keys[i]);
+    }
+    char **sorted = malloc_or_die(count * sizeof(char *));
+    size_t expected = 0, seen = 0, state = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (i % 3)
+            sorted[expected++] = keys[i];
+    }
+    qsort(sorted, expected, sizeof(char *), compare_key);
+    char **value;
+    while ((value = art_iterate(t, &state)) != NULL) {
+        cheat_assert(seen < expected && strcmp(*value, sorted[seen]) == 0);
+        seen++;
+    }
+    cheat_assert_size(seen, expected);
+    free(sorted);
+    for (size_t i = 1; i < count; i++) {
+        if (i % 3)
+            art_remove(t, keys[i]);
+    }
+    free_keys();
+)
+
+CHEAT_TEST(test_art_next,
+    /* The key to start after does not need to be in the tree */
+    char *a = "a_very_long_shared_prefix_0", *b = "a_very_long_shared_prefix_2", *c = "b";
+    cheat_assert_pointer(art_next(t, NULL), NULL);
+    cheat_assert(art_insert(t, &a));
+    cheat_assert(art_insert(t, &b));
+    cheat_assert(art_insert(t, &c));
+    cheat_assert_pointer(art_next(t, NULL), &a);
+    cheat_assert_pointer(art_next(t, ""), &a);
+    cheat_assert_pointer(art_next(t, "a_very_long_shared_prefix_0"), &b);
+    cheat_assert_pointer(art_next(t, "a_very_long_shared_prefix_1"), &b);
+    cheat_assert_pointer(art_next(t, "a_very_long_shared"), &a);
+    cheat_assert_pointer(art_next(t, "a_very_long_shared_prefix_20"), &c);
+    cheat_assert_pointer(art_next(t, "a_very_long_sharez"), &c);
+    cheat_assert_pointer(art_next(t, "b"), NULL);
+    art_remove(t, "a_very_long_shared_prefix_0");
+    art_remove(t, "a_very_long_shared_prefix_2");
+    art_remove(t, "b");
+)
+
+CHEAT_TEST(test_art_walk,
+    fill_keys();
+    for (size_t i = 0; i < count; i++) {
+        cheat_assert(art_insert(t, &keys[i]));
+    }
+    char **last = NULL;
+    art_walk(t, check_order, &last);
+    cheat_assert_pointer(last, art_get(t, "\xff" "c"));
+    for (size_t i = 0; i < count; i++) {
+        art_remove(t, keys[i]);
+    }
+    free_keys();
+)
@@ -0,0 +1,160 @@
+#include <pthread.h>
+
+#include "cheat.h"
+#include "cheats.h"
+#include "utils.h"
+#include "hashtable.h"
+
+/* Readers hammer a table while writers keep filling and emptying it, which
+ * grows and shrinks it over and over. Stable keys must always be found,
+ * churning keys found with their own value or not at all. Checks run in the
+ * threads, which count their failures instead of asserting. Values are
+ * &keys[i], as keyless tables need. */
+CHEAT_DECLARE(
+    enum { STABLE = 512, CHURN = 2048, WRITERS = 2, READERS = 4, ROUNDS = 32 };
+
+    hashtable_t *t;
+    char *stable[STABLE];
+    char *churn[CHURN];
+    int stop;
+    int failures;
+
+    void *read_loop(void *arg) {
+        (void) arg;
+        size_t i = 0;
+        while (!__atomic_load_n(&stop, __ATOMIC_ACQUIRE)) {
+            if (hashtable_get(t, stable[i % STABLE]) != &stable[i % STABLE])
+                __atomic_fetch_add(&failures, 1, __ATOMIC_RELAXED);
+            void *value = hashtable_get(t, churn[i % CHURN]);
+            if (value != NULL && value != &churn[i % CHURN])
+                __atomic_fetch_add(&failures, 1, __ATOMIC_RELAXED);
+            if (i % 1024 == 0) {
+                /* Whatever the iteration skips, it returns entries only */
+                size_t state = 0;
+                char **entry;
+                while ((entry = hashtable_iterate(t, &state)) != NULL) {
+                    if (!(entry >= stable && entry < stable + STABLE)
+                        && !(entry >= churn && entry < churn + CHURN))
+                        __atomic_fetch_add(&failures, 1, __ATOMIC_RELAXED);
+                }
+            }
+            i++;
+        }
+        return NULL;
+    }
+
+    void *read_once(void *arg) {
+        if (hashtable_get(t, *(char **) arg) != arg)
+            __atomic_fetch_add(&failures, 1, __ATOMIC_RELAXED);
+        return NULL;
+    }
+
+    /* Writer number w owns the churning keys i with i % WRITERS == w */
+    void *write_loop(void *arg) {
+        size_t w = (size_t) arg;
+        for (int round = 0; round < ROUNDS; round++) {
+            for (size_t i = w; i < CHURN; i += WRITERS) {
+                if (!hashtable_set(t, churn[i], &churn[i]))
+                    __atomic_fetch_add(&failures, 1, __ATOMIC_RELAXED);
+            }
+            for (size_t i = w; i < CHURN; i += WRITERS)
+                hashtable_remove(t, churn[i]);
+        }
+        return NULL;
+    }
+
+    /* Writer number w sets the stable keys i with i % READERS == w, once
+     * all of them are running, then reads every key */
+    int started;
+
+    void *first_hash_loop(void *arg) {
+        size_t w = (size_t) arg;
+        __atomic_fetch_add(&started, 1, __ATOMIC_RELAXED);
+        while (__atomic_load_n(&started, __ATOMIC_RELAXED) < READERS)
+            ;
+        for (size_t i = w; i < STABLE; i += READERS) {
+            if (!hashtable_set(t, stable[i], &stable[i]))
+                __atomic_fetch_add(&failures, 1, __ATOMIC_RELAXED);
+        }
+        for (size_t i = 0; i < STABLE; i++) {
+            void *value = hashtable_get(t, stable[i]);
+            if (value != NULL && value != &stable[i])
+                __atomic_fetch_add(&failures, 1, __ATOMIC_RELAXED);
+        }
+        return NULL;
+    }
+
+    char *make_key(const char *prefix, size_t i) {
+        char *key = malloc_or_die(16);
+        sprintf(key, "%s%zu", prefix, i);
+        return key;
+    }
+)
+
+CHEAT_SET_UP(
+    t = hashtable_create();
+    for (size_t i = 0; i < STABLE; i++)
+        stable[i] = make_key("stable", i);
+    for (size_t i = 0; i < CHURN; i++)
+        churn[i] = make_key("churn", i);
+    stop = 0;
+    failures = 0;
+)
+
+CHEAT_TEAR_DOWN(
+    hashtable_destroy(t);
+    for (size_t i = 0; i < STABLE; i++)
+        free(stable[i]);
+    for (size_t i = 0; i < CHURN; i++)
+        free(churn[i]);
+)
+
+CHEAT_TEST(test_concurrent_stress,
+    pthread_t readers[READERS], writers[WRITERS];
+    for (size_t i = 0; i < STABLE; i++)
+        cheat_assert(hashtable_set(t, stable[i], &stable[i]));
+    for (size_t i = 0; i < READERS; i++)
+        cheat_assert_int(pthread_create(&readers[i], NULL, read_loop, NULL), 0);
+    for (size_t i = 0; i < WRITERS; i++)
+        cheat_assert_int(pthread_create(&writers[i], NULL, write_loop, (void *) i), 0);
+    for (size_t i = 0; i < WRITERS; i++)
+        pthread_join(writers[i], NULL);
+    __atomic_store_n(&stop, 1, __ATOMIC_RELEASE);
+    for (size_t i = 0; i < READERS; i++)
+        pthread_join(readers[i], NULL);
+    cheat_assert_int(failures, 0);
+    cheat_assert_size(hashtable_get_size(t), STABLE);
+    for (size_t i = 0; i < CHURN; i++)
+        cheat_assert_pointer(hashtable_get(t, churn[i]), NULL);
+)
+
+CHEAT_TEST(test_concurrent_reader_threads,
+    /* Registry slots of exited threads get reused: many more threads than
+     * the registry holds, a few at a time */
+    cheat_assert(hashtable_set(t, stable[0], &stable[0]));
+    for (int batch = 0; batch < 128; batch++) {
+        pthread_t readers[READERS];
+        for (size_t i = 0; i < READERS; i++)
+            cheat_assert_int(pthread_create(&readers[i], NULL, read_once, &stable[0]), 0);
+        for (size_t i = 0; i < READERS; i++)
+            pthread_join(readers[i], NULL);
+        hashtable_resize(t, batch % 2 ? 64 : 32);
+    }
+    cheat_assert_int(failures, 0);
+    cheat_assert_pointer(hashtable_get(t, stable[0]), &stable[0]);
+)
+
+CHEAT_TEST(test_concurrent_first_hash,
+    /* Each test runs in a process of its own, where nothing was hashed yet:
+     * the threads race to pick the hash seed, and must agree on it */
+    pthread_t threads[READERS];
+    started = 0;
+    for (size_t i = 0; i < READERS; i++)
+        cheat_assert_int(pthread_create(&threads[i], NULL, first_hash_loop, (void *) i), 0);
+    for (size_t i = 0; i < READERS; i++)
+        pthread_join(threads[i], NULL);
+    cheat_assert_int(failures, 0);
+    cheat_assert_size(hashtable_get_size(t), STABLE);
+    for (size_t i = 0; i < STABLE; i++)
+        cheat_assert_pointer(hashtable_get(t, stable[i]), &stable[i]);
+)
@@ -1,7 +1,12 @@
 #include "cheat.h"
 #include "cheats.h"
 #include "utils.h"
+#include "hash.h"
 #include "hashtable.h"
+#include "test_hashtable_template.h"
+#ifdef HT_STATS
+#include "hashtable_stats.h"
+#endif
 
 CHEAT_DECLARE(
     hashtable_t *t;
@@ -55,4 +60,394 @@ CHEAT_TEST(test_hashtable_hammer,
         cheat_assert_pointer(hashtable_get(t, keys[i - 1]), NULL);
         free(keys[i - 1]);
     }
-)
\ No newline at end of file
+)
+
+CHEAT_TEST(test_hashtable_large,
+    /* Well past the 16-bit sizes and capacities tables used to have */
+    size_t count = 100000;
+    char **keys = malloc_or_die(count * sizeof(char *));
+    for (size_t i = 0; i < count; i++) {
+        keys[i] = malloc_or_die(8 * sizeof(char));
+        sprintf(keys[i], "%d", (int) i);
+        cheat_assert(hashtable_set(t, keys[i], &keys[i]));
+    }
+    cheat_assert_size(hashtable_get_size(t), count);
+    cheat_assert(t->capacity > count);
+    for (size_t i = 0; i < count; i++) {
+        cheat_assert_pointer(hashtable_get(t, keys[i]), &keys[i]);
+    }
+    for (size_t i = 0; i < count; i++) {
+        hashtable_remove(t, keys[i]);
+        free(keys[i]);
+    }
+    cheat_assert_size(hashtable_get_size(t), 0);
+    free(keys);
+)
+
+CHEAT_TEST(test_hashtable_iterate,
+    char *keys[100];
+    size_t seen = 0, state = 0;
+    for (size_t i = 0; i < 100; i++) {
+        keys[i] = malloc_or_die(5 * sizeof(char));
+        sprintf(keys[i], "%d", (int) i);
+        cheat_assert(hashtable_set(t, keys[i], keys[i]));
+    }
+    char *value;
+    while ((value = hashtable_iterate(t, &state)) != NULL) {
+        cheat_assert_pointer(hashtable_get(t, value), value);
+        seen++;
+    }
+    cheat_assert_size(seen, 100);
+    for (size_t i = 0; i < 100; i++) {
+        hashtable_remove(t, keys[i]);
+        free(keys[i]);
+    }
+)
+
+CHEAT_TEST(test_hashtable_churn,
+    /* Interleave inserts and removals, so that freed slots get reused */
+    char *keys[512];
+    for (size_t i = 0; i < 512; i++) {
+        keys[i] = malloc_or_die(5 * sizeof(char));
+        sprintf(keys[i], "%d", (int) i);
+    }
+    for (size_t round = 0; round < 16; round++) {
+        for (size_t i = round % 2; i < 512; i += 2) {
+            cheat_assert(hashtable_set(t, keys[i], keys[i]));
+        }
+        for (size_t i = round % 2; i < 512; i += 4) {
+            hashtable_remove(t, keys[i]);
+        }
+        for (size_t i = round % 2; i < 512; i += 2) {
+            cheat_assert_pointer(hashtable_get(t, keys[i]), i % 4 == round % 2 ? NULL : keys[i]);
+        }
+        for (size_t i = round % 2 + 2; i < 512; i += 4) {
+            hashtable_remove(t, keys[i]);
+        }
+        cheat_assert_size(hashtable_get_size(t), 0);
+    }
+    for (size_t i = 0; i < 512; i++) {
+        free(keys[i]);
+    }
+)
+
+CHEAT_TEST(test_hashtable_churn_distinct,
+    /* Set and remove keys never seen before, around a few that stay: the
+     * table never grows, and must still drop what removals leave behind */
+    char *stable[10];
+    char key[16];
+    for (size_t i = 0; i < 10; i++) {
+        stable[i] = malloc_or_die(16);
+        sprintf(stable[i], "k%d", (int) i);
+        cheat_assert(hashtable_set(t, stable[i], &stable[i]));
+    }
+    for (size_t i = 0; i < 20000; i++) {
+        char *churn = key;
+        sprintf(key, "x%d", (int) i);
+        cheat_assert(hashtable_set(t, key, &churn));
+        cheat_assert_pointer(hashtable_get(t, key), &churn);
+        hashtable_remove(t, key);
+        cheat_assert_pointer(hashtable_get(t, key), NULL);
+    }
+    cheat_assert_size(hashtable_get_size(t), 10);
+    for (size_t i = 0; i < 10; i++) {
+        cheat_assert_pointer(hashtable_get(t, stable[i]), &stable[i]);
+        free(stable[i]);
+    }
+)
+
+CHEAT_TEST(test_hash_alignment,
+    /* Keys are read word-wise, but their address must not matter */
+    uint64_t (*fns[])(const char *, size_t, uint64_t) = {
+        hash_murmur, hash_wyhash, hash_xxh3, hash_crc32c
+    };
+    char src[320], buf[328];
+    for (size_t i = 0; i < sizeof(src); i++) {
+        src[i] = (char) (i * 31 + 7);
+    }
+    for (size_t f = 0; f < sizeof(fns) / sizeof(fns[0]); f++) {
+        for (size_t len = 0; len <= sizeof(src); len += len < 20 ? 1 : 13) {
+            uint64_t h = fns[f](src, len, 42);
+            for (size_t off = 1; off < 8; off++) {
+                memcpy(buf + off, src, len);
+                cheat_assert(fns[f](buf + off, len, 42) == h);
+            }
+        }
+    }
+    /* Overlapping reads see the same bytes, the length must tell them apart */
+    for (size_t f = 0; f < sizeof(fns) / sizeof(fns[0]); f++) {
+        for (size_t len = 1; len < 24; len++) {
+            cheat_assert(fns[f]("aaaaaaaaaaaaaaaaaaaaaaaa", len, 42)
+                         != fns[f]("aaaaaaaaaaaaaaaaaaaaaaaa", len - 1, 42));
+        }
+    }
+)
+
+CHEAT_TEST(test_hash_seed,
+    uint64_t seed = hash_get_seed();
+    uint64_t h = hash_string("seeded", 6);
+    hash_set_seed(seed + 1);
+    cheat_assert(hash_string("seeded", 6) != h);
+    hash_set_seed(seed);
+    cheat_assert(hash_string("seeded", 6) == h);
+)
+
+CHEAT_TEST(test_hashtable_shrink,
+    /* Emptying a large table must give memory back, keeping what is left */
+    char *keys[1024];
+    for (size_t i = 0; i < 1024; i++) {
+        keys[i] = malloc_or_die(5 * sizeof(char));
+        sprintf(keys[i], "%d", (int) i);
+        cheat_assert(hashtable_set(t, keys[i], keys[i]));
+    }
+    uint32_t grown = t->capacity;
+    for (size_t i = 8; i < 1024; i++) {
+        hashtable_remove(t, keys[i]);
+    }
+    for (size_t i = 0; i < 1024; i++) {
+        cheat_assert_pointer(hashtable_get(t, keys[i]), i < 8 ? keys[i] : NULL);
+    }
+    /* Let a pending migration finish, shrinks never overlap with it */
+    for (size_t round = 0; round < 256; round++) {
+        cheat_assert(hashtable_set(t, keys[8], keys[8]));
+        hashtable_remove(t, keys[8]);
+    }
+    cheat_assert(t->capacity < grown / 8);
+    /* Hovering around the threshold must not resize at every operation */
+    uint32_t capacity = t->capacity;
+    for (size_t round = 0; round < 64; round++) {
+        cheat_assert(hashtable_set(t, keys[8], keys[8]));
+        hashtable_remove(t, keys[8]);
+    }
+    cheat_assert_size(t->capacity, capacity);
+    for (size_t i = 0; i < 1024; i++) {
+        free(keys[i]);
+    }
+)
+
+CHEAT_TEST(test_hashtable_compact,
+    char *keys[256];
+    for (size_t i = 0; i < 256; i++) {
+        keys[i] = malloc_or_die(5 * sizeof(char));
+        sprintf(keys[i], "%d", (int) i);
+        cheat_assert(hashtable_set(t, keys[i], keys[i]));
+    }
+    for (size_t i = 4; i < 256; i += 2) {
+        hashtable_remove(t, keys[i]);
+    }
+    hashtable_compact(t);
+    cheat_assert_size(hashtable_get_size(t), 130);
+    for (size_t i = 0; i < 256; i++) {
+        cheat_assert_pointer(hashtable_get(t, keys[i]), i >= 4 && i % 2 == 0 ? NULL : keys[i]);
+    }
+    for (size_t i = 0; i < 256; i++) {
+        if (i >= 4 && i % 2 == 0)
+            continue;
+        hashtable_remove(t, keys[i]);
+    }
+    hashtable_compact(t);
+    cheat_assert_size(t->capacity, 32);
+    for (size_t i = 0; i < 256; i++) {
+        free(keys[i]);
+    }
+)
+
+CHEAT_TEST(test_template_u64map,
+    u64map_t *m = u64map_create();
+    for (uint64_t i = 0; i < 20000; i++) {
+        cheat_assert(u64map_set(m, i * 3, i));
+    }
+    cheat_assert_not(u64map_set(m, 0, 1));
+    cheat_assert_size(u64map_get_size(m), 20000);
+    for (uint64_t i = 0; i < 60000; i++) {
+        uint64_t *value = u64map_find(m, i);
+        cheat_assert(i % 3 ? value == NULL : value != NULL && *value == i / 3);
+    }
+    for (uint64_t i = 0; i < 20000; i += 2) {
+        cheat_assert(u64map_remove(m, i * 3));
+    }
+    cheat_assert_not(u64map_remove(m, 0));
+    size_t state = 0, seen = 0;
+    uint64_t *value;
+    while ((value = u64map_iterate(m, &state)) != NULL) {
+        cheat_assert(*value % 2 == 1);
+        seen++;
+    }
+    cheat_assert_size(seen, 10000);
+    for (uint64_t i = 1; i < 20000; i += 2) {
+        cheat_assert(u64map_remove(m, i * 3));
+    }
+    u64map_compact(m);
+    cheat_assert_size(m->capacity, 32);
+    u64map_destroy(m);
+)
+
+CHEAT_TEST(test_template_strmap,
+    /* Embedded in place, with a small initial capacity */
+    strmap_t m;
+    char *keys[1024];
+    strmap_init(&m);
+    cheat_assert_size(m.capacity, 8);
+    for (int i = 0; i < 1024; i++) {
+        keys[i] = malloc_or_die(5 * sizeof(char));
+        sprintf(keys[i], "%d", i);
+        cheat_assert(strmap_set(&m, keys[i], -i));
+    }
+    for (int i = 0; i < 1024; i++) {
+        cheat_assert(*strmap_find(&m, keys[i]) == -i);
+    }
+    cheat_assert_pointer(strmap_find(&m, "1024"), NULL);
+    for (int i = 0; i < 1020; i++) {
+        cheat_assert(strmap_remove(&m, keys[i]));
+    }
+    cheat_assert(m.capacity <= 32);
+    cheat_assert(*strmap_find(&m, "1023") == -1023);
+    strmap_release(&m);
+    for (int i = 0; i < 1024; i++) {
+        free(keys[i]);
+    }
+)
+
+CHEAT_TEST(test_template_keyset,
+    keyset_t *m = keyset_create();
+    char *keys[512];
+    for (int i = 0; i < 512; i++) {
+        keys[i] = malloc_or_die(5 * sizeof(char));
+        sprintf(keys[i], "%d", i);
+        cheat_assert(keyset_set(m, keys[i], &keys[i]));
+        /* Never above its own maximum load */
+        cheat_assert(m->size <= m->capacity / 2);
+    }
+    char *same = "42";
+    cheat_assert_not(keyset_set(m, same, &same));
+    for (int i = 0; i < 512; i++) {
+        cheat_assert_pointer(*keyset_find(m, keys[i]), &keys[i]);
+        cheat_assert(keyset_remove(m, keys[i]));
+        cheat_assert_pointer(keyset_find(m, keys[i]), NULL);
+    }
+    cheat_assert_size(keyset_get_size(m), 0);
+    keyset_destroy(m);
+    for (int i = 0; i < 512; i++) {
+        free(keys[i]);
+    }
+)
+
+#if HT_ENGINE == HT_ENGINE_DENSE
+CHEAT_TEST(test_hashtable_dense_order,
+    /* Iteration follows insertion, across removals and growth */
+    char *keys[300];
+    for (size_t i = 0; i < 300; i++) {
+        keys[i] = malloc_or_die(5 * sizeof(char));
+        sprintf(keys[i], "%d", (int) i);
+        cheat_assert(hashtable_set(t, keys[i], keys[i]));
+        if (i % 3 == 0)
+            hashtable_remove(t, keys[i / 2]);
+    }
+    size_t state = 0, last = 0, count = 0;
+    char *value;
+    while ((value = hashtable_iterate(t, &state)) != NULL) {
+        size_t i = (size_t) atoi(value);
+        cheat_assert(count == 0 || i > last);
+        last = i;
+        count++;
+    }
+    cheat_assert_size(count, hashtable_get_size(t));
+    for (size_t i = 0; i < 300; i++) {
+        free(keys[i]);
+    }
+)
+#endif
+
+#ifdef HT_INCREMENTAL_RESIZE
+CHEAT_TEST(test_hashtable_incremental_resize_bounded,
+    /* No insertion moves more than HT_MIGRATE_STEP entries, and every
+     * migration is over before the table needs to grow again */
+    char *keys[20000];
+    size_t migrations = 0;
+    for (size_t i = 0; i < 20000; i++) {
+        keys[i] = malloc_or_die(6 * sizeof(char));
+        sprintf(keys[i], "%d", (int) i);
+        bool pending = t->old_body != NULL;
+        size_t old_size = t->old_size;
+        uint32_t capacity = t->capacity;
+        cheat_assert(hashtable_set(t, keys[i], keys[i]));
+        if (t->capacity != capacity) {
+            cheat_assert_not(pending);
+            migrations++;
+        } else if (pending) {
+            cheat_assert(old_size - (t->old_body ? t->old_size : 0) <= HT_MIGRATE_STEP);
+        }
+    }
+    cheat_assert(migrations > 5);
+    for (size_t i = 0; i < 20000; i++) {
+        cheat_assert_pointer(hashtable_get(t, keys[i]), keys[i]);
+    }
+    for (size_t i = 0; i < 20000; i++) {
+        hashtable_remove(t, keys[i]);
+        free(keys[i]);
+    }
+    cheat_assert_size(hashtable_get_size(t), 0);
+)
+#endif
+
+#ifdef HT_STATS
+CHEAT_TEST(test_hashtable_stats,
+    char *keys[100];
+    hashtable_stats_t stats;
+    hashtable_stats_reset();
+    hashtable_stats_get(&stats);
+    uint64_t entries = stats.entries, slots = stats.slots;
+    for (size_t i = 0; i < 100; i++) {
+        keys[i] = malloc_or_die(5 * sizeof(char));
+        sprintf(keys[i], "%d", (int) i);
+        cheat_assert(hashtable_set(t, keys[i], &keys[i]));
+    }
+    for (size_t i = 0; i < 100; i++) {
+        cheat_assert_pointer(hashtable_get(t, keys[i]), &keys[i]);
+    }
+    cheat_assert_pointer(hashtable_get(t, "missing"), NULL);
+    hashtable_stats_get(&stats);
+    uint64_t gets = 0, sets = 0;
+    for (int b = 0; b < HT_STATS_BUCKETS; b++) {
+        gets += stats.probes[HT_STATS_GET][b];
+        sets += stats.probes[HT_STATS_SET][b];
+    }
+    cheat_assert(gets == 101 && sets == 100);
+    cheat_assert(stats.probes_total[HT_STATS_GET] >= 101);
+    /* 32 -> 64 at the 26th key, -> 128 at the 52nd */
+    cheat_assert(stats.grows == 2 && stats.shrinks == 0);
+    cheat_assert(stats.bytes_moved == (25 + 51) * sizeof(hashtable_entry_t));
+    cheat_assert(stats.entries - entries == 100 && stats.slots - slots == 128 - 32);
+    cheat_assert(stats.max_cluster >= 1 && stats.max_cluster <= 100);
+    for (size_t i = 0; i < 100; i++) {
+        hashtable_remove(t, keys[i]);
+        free(keys[i]);
+    }
+    hashtable_stats_get(&stats);
+    cheat_assert(stats.shrinks == 2 && stats.entries == entries && stats.slots == slots);
+)
+
+CHEAT_TEST(test_hashtable_stats_peak,
+    /* Emptied and destroyed tables still report the load they ran at */
+    char *keys[100];
+    hashtable_stats_t stats;
+    hashtable_stats_reset();
+    hashtable_stats_get(&stats);
+    uint64_t entries = stats.entries, slots = stats.slots;
+    hashtable_t *other = hashtable_create();
+    for (size_t i = 0; i < 100; i++) {
+        keys[i] = malloc_or_die(5 * sizeof(char));
+        sprintf(keys[i], "%d", (int) i);
+        cheat_assert(hashtable_set(other, keys[i], &keys[i]));
+    }
+    for (size_t i = 0; i < 100; i++) {
+        hashtable_remove(other, keys[i]);
+        free(keys[i]);
+    }
+    hashtable_destroy(other);
+    hashtable_stats_get(&stats);
+    cheat_assert(stats.entries == entries && stats.slots == slots);
+    cheat_assert(stats.peak_tables == stats.tables + 1);
+    cheat_assert(stats.peak_entries == entries + 100 && stats.peak_slots == slots + 128);
+)
+#endif
@@ -0,0 +1,119 @@
+#include "cheat.h"
+#include "cheats.h"
+#include "utils.h"
+#include "hashtable.h"
+
+/* Keyless tables read the key through the value, which must point to it
+ * HT_KEY_OFFSET bytes in: values are records named like a node_t, and
+ * never NULL */
+CHEAT_DECLARE(
+    typedef struct {
+        char *name;
+        int number;
+    } record_t;
+
+    hashtable_t *t;
+    record_t *records;
+
+    void make_records(size_t count) {
+        records = malloc_or_die(count * sizeof(record_t));
+        for (size_t i = 0; i < count; i++) {
+            records[i].name = malloc_or_die(8);
+            sprintf(records[i].name, "%d", (int) i);
+            records[i].number = (int) i;
+        }
+    }
+
+    void free_records(size_t count) {
+        for (size_t i = 0; i < count; i++)
+            free(records[i].name);
+        free(records);
+    }
+)
+
+CHEAT_SET_UP(
+    t = hashtable_create();
+)
+
+CHEAT_TEAR_DOWN(
+    hashtable_destroy(t);
+)
+
+CHEAT_TEST(test_keyless_key_offset,
+    cheat_assert_size(HT_KEY_OFFSET, 0);
+    cheat_assert_size(sizeof(hashtable_entry_t), 16);
+)
+
+CHEAT_TEST(test_keyless_set_get_remove,
+    /* Lookups take any string equal to the name */
+    char copy[8];
+    make_records(1);
+    cheat_assert(hashtable_set(t, records[0].name, &records[0]));
+    cheat_assert_not(hashtable_set(t, records[0].name, &records[0]));
+    strcpy(copy, records[0].name);
+    cheat_assert_pointer(hashtable_get(t, copy), &records[0]);
+    cheat_assert_pointer(hashtable_get(t, "1"), NULL);
+    hashtable_remove(t, copy);
+    cheat_assert_size(hashtable_get_size(t), 0);
+    cheat_assert_pointer(hashtable_get(t, records[0].name), NULL);
+    free_records(1);
+)
+
+CHEAT_TEST(test_keyless_hammer,
+    make_records(20000);
+    for (size_t i = 0; i < 20000; i++) {
+        cheat_assert(hashtable_set(t, records[i].name, &records[i]));
+    }
+    cheat_assert_size(hashtable_get_size(t), 20000);
+    size_t state = 0, seen = 0;
+    record_t *record;
+    while ((record = hashtable_iterate(t, &state)) != NULL) {
+        cheat_assert_pointer(hashtable_get(t, record->name), record);
+        seen++;
+    }
+    cheat_assert_size(seen, 20000);
+    for (size_t i = 0; i < 20000; i += 2) {
+        hashtable_remove(t, records[i].name);
+    }
+    hashtable_compact(t);
+    for (size_t i = 0; i < 20000; i++) {
+        cheat_assert_pointer(hashtable_get(t, records[i].name), i % 2 ? &records[i] : NULL);
+    }
+    for (size_t i = 1; i < 20000; i += 2) {
+        hashtable_remove(t, records[i].name);
+    }
+    cheat_assert_size(hashtable_get_size(t), 0);
+    free_records(20000);
+)
+
+CHEAT_TEST(test_keyless_churn,
+    /* Distinct keys set and removed around a few that stay */
+    make_records(10010);
+    for (size_t i = 0; i < 10; i++) {
+        cheat_assert(hashtable_set(t, records[i].name, &records[i]));
+    }
+    for (size_t i = 10; i < 10010; i++) {
+        cheat_assert(hashtable_set(t, records[i].name, &records[i]));
+        hashtable_remove(t, records[i].name);
+        cheat_assert_pointer(hashtable_get(t, records[i].name), NULL);
+    }
+    cheat_assert_size(hashtable_get_size(t), 10);
+    for (size_t i = 0; i < 10; i++) {
+        cheat_assert_pointer(hashtable_get(t, records[i].name), &records[i]);
+    }
+    free_records(10010);
+)
+
+#if HT_ENGINE == HT_ENGINE_CUCKOO
+CHEAT_TEST(test_keyless_cuckoo_bucket_lines,
+    /* A bucket is one cache line, from the first body to the last */
+    cheat_assert_size(4 * sizeof(hashtable_entry_t), 64);
+    cheat_assert_size((uintptr_t) t->body % 64, 0);
+    make_records(1000);
+    for (size_t i = 0; i < 1000; i++) {
+        cheat_assert(hashtable_set(t, records[i].name, &records[i]));
+        cheat_assert_size((uintptr_t) t->body % 64, 0);
+    }
+    free_records(1000);
+)
+#endif
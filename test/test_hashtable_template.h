@@ -0,0 +1,43 @@
+#ifndef TEST_HASHTABLE_TEMPLATE_H
+#define TEST_HASHTABLE_TEMPLATE_H
+
+/* Instances of the hashtable template under test, declared once however
+ * many times cheat includes the test file */
+#include <string.h>
+#include "hash.h"
+
+static inline uint64_t test_mix64(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xFF51AFD7ED558CCDULL;
+    x ^= x >> 33;
+    return x;
+}
+
+/* Integer keys and values, 0 included */
+#define HT_T_NAME u64map
+#define HT_T_KEY uint64_t
+#define HT_T_VALUE uint64_t
+#define HT_T_HASH(k) test_mix64(k)
+#define HT_T_EQUAL(a, b) ((a) == (b))
+#include "hashtable_template.h"
+
+/* String keys, as hashtable_linear in hashtable.h, with int values */
+#define HT_T_NAME strmap
+#define HT_T_KEY const char *
+#define HT_T_VALUE int
+#define HT_T_HASH(k) hash_string((k), strlen(k))
+#define HT_T_EQUAL(a, b) (strcmp((a), (b)) == 0)
+#define HT_T_INITIAL_CAPACITY 8
+#include "hashtable_template.h"
+
+/* Keys read through the values, which point to them: values are &keys[i] */
+#define HT_T_NAME keyset
+#define HT_T_KEY const char *
+#define HT_T_VALUE char **
+#define HT_T_KEY_OF(v) (*(v))
+#define HT_T_HASH(k) hash_string((k), strlen(k))
+#define HT_T_EQUAL(a, b) (strcmp((a), (b)) == 0)
+#define HT_T_MAX_LOAD 0.5
+#include "hashtable_template.h"
+
+#endif //TEST_HASHTABLE_TEMPLATE_H
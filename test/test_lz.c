@@ -0,0 +1,95 @@
+#include "cheat.h"
+#include "cheats.h"
+#include "utils.h"
+#include "lz.h"
+
+CHEAT_DECLARE(
+    /* Compress and decompress n bytes, return the compressed size */
+    size_t round_trip(const char *bytes, size_t n) {
+        char *packed = malloc_or_die(LZ_BOUND(n));
+        char *unpacked = malloc_or_die(n + 1);
+        size_t size = lz_compress(bytes, n, packed, LZ_BOUND(n));
+        cheat_assert(size > 0 && size <= LZ_BOUND(n));
+        cheat_assert(lz_decompress(packed, size, unpacked, n));
+        cheat_assert(memcmp(bytes, unpacked, n) == 0);
+        free(packed);
+        free(unpacked);
+        return size;
+    }
+
+    /* Text of n bytes made of a few words */
+    char *words(size_t n) {
+        static const char *dictionary[] = { "lorem ", "ipsum ", "dolor ", "sit ", "amet, ",
+                                            "consectetur ", "adipiscing ", "elit. " };
+        char *text = malloc_or_die(n + 1);
+        size_t len = 0;
+        for (unsigned seed = 1; len < n; seed = seed * 1103515245 + 12345) {
+            const char *word = dictionary[(seed >> 16) % 8];
+            for (size_t i = 0; word[i] && len < n; i++)
+                text[len++] = word[i];
+        }
+        text[n] = '\0';
+        return text;
+    }
+
+    /* Bytes of n that do not compress */
+    char *noise(size_t n) {
+        char *bytes = malloc_or_die(n);
+        uint64_t state = 88172645463325252ULL;
+        for (size_t i = 0; i < n; i++) {
+            state ^= state << 13;
+            state ^= state >> 7;
+            state ^= state << 17;
+            bytes[i] = (char) state;
+        }
+        return bytes;
+    }
+)
+
+CHEAT_TEST(test_lz_round_trip,
+    // Sizes around the limits of the match search, and of length bytes
+    size_t sizes[] = { 0, 1, 4, 12, 13, 14, 15, 16, 255, 270, 4096, 65536, 70000, 300000 };
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        char *text = words(sizes[i]);
+        round_trip(text, sizes[i]);
+        free(text);
+        char *bytes = noise(sizes[i]);
+        round_trip(bytes, sizes[i]);
+        free(bytes);
+    }
+)
+
+CHEAT_TEST(test_lz_ratio,
+    // Text compresses, a run of one byte to almost nothing, noise not at
+    // all but within the bound
+    char *text = words(65536);
+    cheat_assert(round_trip(text, 65536) < 65536 / 2);
+    memset(text, 'x', 65536);
+    cheat_assert(round_trip(text, 65536) < 300);
+    free(text);
+    char *bytes = noise(65536);
+    cheat_assert(round_trip(bytes, 65536) > 65536);
+    // A buffer too small is reported, not overflowed
+    char small[100];
+    cheat_assert_size(lz_compress(bytes, 65536, small, sizeof(small)), 0);
+    free(bytes);
+)
+
+CHEAT_TEST(test_lz_corrupted,
+    // Every truncation and every flipped byte either fails or stays in
+    // bounds: the output buffer is exactly the expected size
+    char *text = words(2000);
+    char packed[LZ_BOUND(2000)];
+    char unpacked[2000];
+    size_t size = lz_compress(text, 2000, packed, sizeof(packed));
+    for (size_t cut = 0; cut < size; cut++)
+        cheat_assert_not(lz_decompress(packed, cut, unpacked, 2000));
+    for (size_t i = 0; i < size; i++) {
+        packed[i] ^= 0x5A;
+        lz_decompress(packed, size, unpacked, 2000);
+        packed[i] ^= 0x5A;
+    }
+    cheat_assert_not(lz_decompress(packed, size, unpacked, 1999));
+    cheat_assert(lz_decompress(packed, size, unpacked, 2000));
+    free(text);
+)
@@ -0,0 +1,84 @@
+#include "cheat.h"
+#include "cheats.h"
+#include "utils.h"
+#include "pool.h"
+
+CHEAT_DECLARE(
+    pool_t pool;
+
+    /* Object size that is not a multiple of the alignment */
+    typedef struct { void *ptr; char tag[13]; } object_t;
+)
+
+CHEAT_SET_UP(
+    pool_init(&pool, sizeof(object_t), 16);
+)
+
+CHEAT_TEAR_DOWN(
+    pool_release(&pool);
+)
+
+CHEAT_TEST(test_pool_alloc,
+    object_t *objects[100];
+    for (size_t i = 0; i < 100; i++) {
+        objects[i] = pool_alloc(&pool);
+        cheat_assert((uintptr_t) objects[i] % sizeof(void *) == 0);
+        sprintf(objects[i]->tag, "%d", (int) i);
+        objects[i]->ptr = objects[i];
+    }
+    cheat_assert_size(pool.used, 100);
+    /* No two objects overlap */
+    for (size_t i = 0; i < 100; i++) {
+        char tag[13];
+        sprintf(tag, "%d", (int) i);
+        cheat_assert_string(objects[i]->tag, tag);
+        cheat_assert_pointer(objects[i]->ptr, objects[i]);
+    }
+    /* Objects of a chunk are contiguous */
+    cheat_assert((char *) objects[1] - (char *) objects[0] == (ptrdiff_t) pool.object_size);
+)
+
+CHEAT_TEST(test_pool_free,
+    object_t *a = pool_alloc(&pool);
+    object_t *b = pool_alloc(&pool);
+    pool_free(&pool, a);
+    pool_free(&pool, b);
+    cheat_assert_size(pool.used, 0);
+    /* Last freed, first reused */
+    cheat_assert_pointer(pool_alloc(&pool), b);
+    cheat_assert_pointer(pool_alloc(&pool), a);
+    cheat_assert_pointer(pool.free, NULL);
+)
+
+CHEAT_TEST(test_pool_reserve,
+    object_t *first = pool_alloc(&pool);
+    pool_reserve(&pool, 1000);
+    struct _pool_chunk *chunk = pool.chunks;
+    /* The rest of the first chunk is kept, then comes the reserved one */
+    object_t *prev = NULL;
+    for (size_t i = 0; i < 1015; i++) {
+        object_t *object = pool_alloc(&pool);
+        cheat_assert(object != first);
+        if (i > 15 && prev != NULL)
+            cheat_assert((char *) object - (char *) prev == (ptrdiff_t) pool.object_size);
+        prev = object;
+    }
+    cheat_assert_pointer(pool.chunks, chunk);
+    cheat_assert_pointer(pool.next, pool.end);
+    pool_release(&pool);
+    cheat_assert_size(pool.used, 0);
+    cheat_assert_pointer(pool.chunks, NULL);
+    cheat_assert(pool_alloc(&pool) != NULL);
+)
+
+CHEAT_TEST(test_pool_reserve_overflow,
+    object_t *first = pool_alloc(&pool);
+    struct _pool_chunk *chunk = pool.chunks;
+    /* Counts whose chunk size would wrap are refused, the pool is kept */
+    cheat_assert_not(pool_reserve(&pool, SIZE_MAX));
+    cheat_assert_not(pool_reserve(&pool, SIZE_MAX / pool.object_size + 1));
+    cheat_assert_pointer(pool.chunks, chunk);
+    cheat_assert(pool_reserve(&pool, 15));
+    cheat_assert_pointer(pool.chunks, chunk);
+    cheat_assert(pool_alloc(&pool) != first);
+)
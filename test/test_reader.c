@@ -0,0 +1,107 @@
+#include <unistd.h>
+
+#include "cheat.h"
+#include "cheats.h"
+#include "utils.h"
+#include "reader.h"
+
+CHEAT_DECLARE(
+    FILE *file;
+    reader_t reader;
+    char *line;
+    size_t len;
+
+    /* Give the reader this input */
+    void input(const char *bytes, size_t n) {
+        fwrite(bytes, 1, n, file);
+        fflush(file);
+        rewind(file);
+        reader_init(&reader, fileno(file));
+    }
+
+    /* A field of n bytes of a pattern, the reader has to get in pieces */
+    char *large_field(size_t n) {
+        char *bytes = malloc_or_die(n + 1);
+        for (size_t i = 0; i < n; i++)
+            bytes[i] = (char) ('a' + i % 26);
+        bytes[n] = '\0';
+        return bytes;
+    }
+)
+
+CHEAT_SET_UP(
+    file = tmpfile();
+    line = NULL;
+    len = 0;
+)
+
+CHEAT_TEAR_DOWN(
+    reader_free(&reader);
+    fclose(file);
+    free(line);
+)
+
+CHEAT_TEST(test_reader_getline,
+    input("first\nsecond \"quoted\"\nlast", 26);
+    cheat_assert_int(reader_getline(&reader, &line, &len, 0, '\n'), 6);
+    cheat_assert_string(line, "first\n");
+    // Cut at the quote, then continued
+    cheat_assert_int(reader_getline(&reader, &line, &len, 0, '"'), 8);
+    cheat_assert_string(line, "second \"");
+    cheat_assert_int(reader_peek(&reader), 'q');
+    cheat_assert_int(reader_getline(&reader, &line, &len, 8, '\n'), 16);
+    cheat_assert_string(line, "second \"quoted\"\n");
+    cheat_assert_int(reader_getline(&reader, &line, &len, 0, '"'), 4);
+    cheat_assert_string(line, "last");
+    cheat_assert_int(reader_getline(&reader, &line, &len, 0, '"'), -1);
+    cheat_assert_int(reader_peek(&reader), EOF);
+)
+
+CHEAT_TEST(test_reader_getfield,
+    input("small\"ignored\nnext\tx\n", 21);
+    char *field = NULL;
+    size_t capacity = 0, n;
+    cheat_assert_int(reader_getfield(&reader, &field, &capacity, &n, "\"\n\r\t"), '"');
+    cheat_assert_string(field, "small");
+    cheat_assert_size(n, 5);
+    reader_skipline(&reader);
+    cheat_assert_int(reader_getfield(&reader, &field, &capacity, &n, "\"\n\r\t"), '\t');
+    cheat_assert_string(field, "next");
+    cheat_assert_int(reader_getfield(&reader, &field, &capacity, &n, "\"\n\r\t"), '\n');
+    cheat_assert_string(field, "x");
+    cheat_assert_int(reader_getfield(&reader, &field, &capacity, &n, "\"\n\r\t"), EOF);
+    cheat_assert_size(n, 0);
+    free(field);
+)
+
+CHEAT_TEST(test_reader_getfield__large,
+    // Grown from the block, then read straight into a field sized in
+    // advance: what follows either stays readable
+    size_t size = 3 * 1024 * 1024 + 7;
+    char *bytes = large_field(size);
+    fwrite(bytes, 1, size, file);
+    fwrite("\"\nafter\n", 1, 8, file);
+    fwrite(bytes, 1, size, file);
+    fwrite("\"\nend", 1, 5, file);
+    input("", 0);
+    char *field = NULL;
+    size_t capacity = 0, n;
+    cheat_assert_int(reader_getfield(&reader, &field, &capacity, &n, "\"\n"), '"');
+    cheat_assert_size(n, size);
+    cheat_assert(memcmp(field, bytes, size + 1) == 0);
+    reader_skipline(&reader);
+    cheat_assert_int(reader_getline(&reader, &line, &len, 0, '\n'), 6);
+    cheat_assert_string(line, "after\n");
+    free(field);
+    field = NULL;
+    capacity = 2 * size;
+    cheat_assert_int(reader_getfield(&reader, &field, &capacity, &n, "\"\n"), '"');
+    cheat_assert_size(capacity, 2 * size);
+    cheat_assert_size(n, size);
+    cheat_assert(memcmp(field, bytes, size + 1) == 0);
+    cheat_assert_int(reader_getline(&reader, &line, &len, 0, '"'), 1);
+    cheat_assert_int(reader_getline(&reader, &line, &len, 0, '"'), 3);
+    cheat_assert_string(line, "end");
+    free(field);
+    free(bytes);
+)
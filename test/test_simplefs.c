@@ -1,6 +1,23 @@
 #include "cheat.h"
 #include "cheats.h"
 #include "simplefs.h"
+#ifdef FS_DIR_GLOBAL
+#include "dirtable.h"
+#endif
+#ifdef FS_DEDUP_CONTENTS
+#include "content.h"
+/* Shared contents are replaced, never written */
+#define REWRITES_IN_PLACE false
+#else
+#define REWRITES_IN_PLACE true
+#endif
+#ifdef FS_INTERN_NAMES
+#include "intern.h"
+#define NAME_STORED(node, len) ((node)->name == intern_get((node)->name))
+#else
+#define NAME_STORED(node, len) ((len) < FS_INLINE_NAME ? (node)->name == (node)->inline_name \
+                                                       : (node)->name != (node)->inline_name)
+#endif
 
 CHEAT_DECLARE(
     node_t *root;
@@ -117,6 +134,77 @@ CHEAT_TEST(test_fs_set$get_file_content__ok,
      fs_delete(node, false);
 )
 
+CHEAT_TEST(test_fs_set_file_content__rewrite,
+     // Short contents stay in the node, long ones get a buffer that
+     // rewrites reuse while they fit
+     char content[256];
+     fs_create(root, "file1", File);
+     node_t *node = fs_find_in_dir(root, "file1");
+     cheat_assert_size(fs_get_file_size(node), 0);
+     cheat_assert(fs_set_file_content(node, "ok"));
+     cheat_assert_pointer(fs_get_file_content(node), node->payload.inline_content);
+     cheat_assert_size(fs_get_file_size(node), 2);
+     memset(content, 'a', 100);
+     content[100] = '\0';
+     cheat_assert(fs_set_file_content(node, content));
+     char *buffer = fs_get_file_content(node);
+     cheat_assert_string(buffer, content);
+     cheat_assert_size(fs_get_file_size(node), 100);
+     content[50] = '\0';
+     cheat_assert(fs_set_file_content(node, content));
+     cheat_assert(!REWRITES_IN_PLACE || fs_get_file_content(node) == buffer);
+     cheat_assert_string(fs_get_file_content(node), content);
+     cheat_assert_size(fs_get_file_size(node), 50);
+     memset(content, 'b', 255);
+     content[255] = '\0';
+     cheat_assert(fs_set_file_content(node, content));
+     cheat_assert_string(fs_get_file_content(node), content);
+     cheat_assert_size(fs_get_file_size(node), 255);
+     cheat_assert(fs_set_file_content(node, ""));
+     cheat_assert_pointer(fs_get_file_content(node), node->payload.inline_content);
+     cheat_assert_string(fs_get_file_content(node), "");
+     fs_delete(node, false);
+)
+
+CHEAT_TEST(test_fs_adopt_file_content,
+     // The buffer itself becomes the content, trimmed if mostly unused
+     fs_create(root, "file1", File);
+     node_t *node = fs_find_in_dir(root, "file1");
+     char *data = malloc_or_die(4096);
+     memset(data, 'a', 1000);
+     data[1000] = '\0';
+     cheat_assert(fs_adopt_file_content(node, data, 1000, 4096));
+     cheat_assert_size(fs_get_file_size(node), 1000);
+     cheat_assert_size(node->payload.buffer.capacity, 1001);
+     cheat_assert_string(fs_get_file_content(node) + 990, "aaaaaaaaaa");
+     data = malloc_or_die(2000);
+     memset(data, 'b', 1999);
+     data[1999] = '\0';
+     cheat_assert(fs_adopt_file_content(node, data, 1999, 2000));
+     cheat_assert_pointer(fs_get_file_content(node), data);
+     // Short ones go in the node
+     data = malloc_or_die(64);
+     strcpy(data, "short");
+     cheat_assert(fs_adopt_file_content(node, data, 5, 64));
+     cheat_assert_pointer(fs_get_file_content(node), node->payload.inline_content);
+     cheat_assert_string(fs_get_file_content(node), "short");
+     cheat_assert_not(fs_adopt_file_content(root, NULL, 0, 0));
+     fs_delete(node, false);
+)
+
+CHEAT_TEST(test_fs_adopt_file_content__too_long_fail,
+     // Lengths whose buffer capacity would not fit a file_buffer_t, the
+     // data is left alone and the file keeps its content
+     fs_create(root, "file1", File);
+     node_t *node = fs_find_in_dir(root, "file1");
+     cheat_assert(fs_set_file_content(node, "Lorem ipsum"));
+     char data[] = "Lorem ipsum dolor";
+     cheat_assert_not(fs_adopt_file_content(node, data, (size_t) FS_CONTENT_MAX + 1, (size_t) FS_CONTENT_MAX + 2));
+     cheat_assert_not(fs_adopt_file_content(node, data, 17, (size_t) UINT32_MAX + 1));
+     cheat_assert_string(fs_get_file_content(node), "Lorem ipsum");
+     fs_delete(node, false);
+)
+
 CHEAT_TEST(test_fs_set_file_content__dir_fail,
      cheat_assert_not(fs_set_file_content(root, "Lorem ipsum"));
 )
@@ -179,4 +267,310 @@ CHEAT_TEST(test_fs_find_r,
      free(res);
      fs_delete(file1, true);
      fs_delete(dir1, true);
-)
\ No newline at end of file
+)
+CHEAT_TEST(test_fs_dir_grow_and_shrink,
+     // Children survive the move to a hashtable and back
+     char buffer[8];
+     node_t *children[3 * SMALL_DIR_NODES];
+     for (int i = 0; i < 3 * SMALL_DIR_NODES; i++) {
+         sprintf(buffer, "f%d", i);
+         cheat_assert(fs_create(root, buffer, File));
+         children[i] = fs_find_in_dir(root, buffer);
+         cheat_assert_not(fs_create(root, buffer, Dir));
+     }
+     for (int i = 0; i < 3 * SMALL_DIR_NODES - 1; i++) {
+         cheat_assert(fs_delete(children[i], false));
+         for (int j = i + 1; j < 3 * SMALL_DIR_NODES; j++) {
+             sprintf(buffer, "f%d", j);
+             cheat_assert_pointer(fs_find_in_dir(root, buffer), children[j]);
+         }
+     }
+     size_t nres = 0;
+     sprintf(buffer, "f%d", 3 * SMALL_DIR_NODES - 1);
+     node_t **res = fs_find_r(root, buffer, &nres, NULL);
+     cheat_assert_size(nres, 1);
+     free(res);
+     fs_delete(children[3 * SMALL_DIR_NODES - 1], false);
+     cheat_assert_pointer(fs_find_in_dir(root, buffer), NULL);
+)
+
+CHEAT_TEST(test_fs_name_lengths,
+     // Short names live in their node, long ones in the name arena (unless
+     // they are all interned)
+     char name[MAX_NAMELENGHT + 1];
+     for (size_t len = 1; len <= MAX_NAMELENGHT; len++) {
+         memset(name, 'a' + (int) (len % 26), len);
+         name[len] = '\0';
+         cheat_assert(fs_create(root, name, File));
+     }
+     for (size_t len = 1; len <= MAX_NAMELENGHT; len++) {
+         memset(name, 'a' + (int) (len % 26), len);
+         name[len] = '\0';
+         node_t *node = fs_find_in_dir(root, name);
+         cheat_assert_not_pointer(node, NULL);
+         cheat_yield();
+         cheat_assert_string(node->name, name);
+         cheat_assert_size(node->name_len, len);
+         cheat_assert(NAME_STORED(node, len));
+         char *path = fs_get_path(node, 0);
+         cheat_assert_size(strlen(path), len + 1);
+         free(path);
+         cheat_assert(fs_delete(node, false));
+     }
+     cheat_assert_pointer(fs_find_in_dir(root, "a"), NULL);
+)
+
+#ifdef FS_DIR_ART
+CHEAT_TEST(test_fs_find_r__ordered,
+     // Results come in path order, small and promoted directories alike
+     char buffer[16];
+     for (int i = 0; i < 4 * SMALL_DIR_NODES; i++) {
+         sprintf(buffer, "d%d", (i * 7) % (4 * SMALL_DIR_NODES));
+         cheat_assert(fs_create(root, buffer, Dir));
+         node_t *dir = fs_find_in_dir(root, buffer);
+         for (int j = 0; j < i % (2 * SMALL_DIR_NODES); j++) {
+             sprintf(buffer, "x%d", (j * 5) % (2 * SMALL_DIR_NODES));
+             cheat_assert(fs_create(dir, buffer, Dir));
+             cheat_assert(fs_create(fs_find_in_dir(dir, buffer), "x1", File));
+         }
+     }
+     size_t nres = 0;
+     node_t **res = fs_find_r(root, "x1", &nres, NULL);
+     cheat_assert(nres > 4 * SMALL_DIR_NODES);
+     char *last = fs_get_path(res[0], 0);
+     for (size_t i = 1; i < nres; i++) {
+         char *path = fs_get_path(res[i], 0);
+         cheat_assert(strcmp(last, path) < 0);
+         free(last);
+         last = path;
+     }
+     free(last);
+     free(res);
+     for (int i = 0; i < 4 * SMALL_DIR_NODES; i++) {
+         sprintf(buffer, "d%d", i);
+         cheat_assert(fs_delete(fs_find_in_dir(root, buffer), true));
+     }
+)
+#endif
+
+#ifdef FS_DIR_GLOBAL
+CHEAT_TEST(test_fs_global_table,
+     // Same names in different directories are different entries
+     fs_create(root, "a", Dir);
+     fs_create(root, "b", Dir);
+     node_t *a = fs_find_in_dir(root, "a");
+     node_t *b = fs_find_in_dir(root, "b");
+     cheat_assert(fs_create(a, "x", File));
+     cheat_assert(fs_create(b, "x", Dir));
+     cheat_assert_not(fs_create(b, "x", File));
+     node_t *bx = fs_find_in_dir(b, "x");
+     cheat_assert_not_pointer(fs_find_in_dir(a, "x"), bx);
+     cheat_assert_uint8(fs_get_type(bx), Dir);
+     cheat_assert(fs_create(bx, "b", File));
+     cheat_assert_pointer(fs_find_in_dir(bx, "a"), NULL);
+     cheat_assert_size(dirtable_get_size(), 5);
+     cheat_assert(fs_delete(b, true));
+     cheat_assert_size(dirtable_get_size(), 2);
+     cheat_assert_uint8(fs_get_type(fs_find_in_dir(a, "x")), File);
+     // Destroying the root drops whatever it holds
+     fs_destroy_root(root);
+     cheat_assert_size(dirtable_get_size(), 0);
+     root = fs_new_root();
+)
+#endif
+
+#ifdef FS_INTERN_NAMES
+CHEAT_TEST(test_fs_interned_names,
+     // Equal names are one string, held as long as some node has it
+     uint32_t size = intern_get_size();
+     fs_create(root, "a", Dir);
+     fs_create(root, "b", Dir);
+     node_t *a = fs_find_in_dir(root, "a");
+     node_t *b = fs_find_in_dir(root, "b");
+     cheat_assert(fs_create(a, "same", File));
+     cheat_assert(fs_create(b, "same", File));
+     cheat_assert_pointer(fs_find_in_dir(a, "same")->name, fs_find_in_dir(b, "same")->name);
+     cheat_assert_uint32(intern_get_size(), size + 3);
+     cheat_assert_pointer(fs_find_in_dir(a, "other"), NULL);
+     size_t nres = 0;
+     cheat_assert_pointer(fs_find_r(root, "other", &nres, NULL), NULL);
+     cheat_assert_size(nres, 0);
+     cheat_assert(fs_delete(a, true));
+     cheat_assert_not_pointer(intern_get("same"), NULL);
+     cheat_assert(fs_delete(b, true));
+     cheat_assert_pointer(intern_get("same"), NULL);
+     cheat_assert_uint32(intern_get_size(), size);
+)
+
+CHEAT_TEST(test_fs_interned_lookup,
+     // Looked up names find their node in small and hashed directories
+     char buffer[16];
+     for (int i = 0; i < 100; i++) {
+         sprintf(buffer, "n%d", i);
+         cheat_assert(fs_create(root, buffer, File));
+     }
+     for (int i = 0; i < 100; i++) {
+         sprintf(buffer, "n%d", i);
+         char *name = fs_lookup_name(buffer);
+         cheat_assert_pointer(name, intern_get(buffer));
+         cheat_assert_pointer(fs_find_name(root, name)->name, name);
+     }
+     cheat_assert_pointer(fs_lookup_name("missing"), NULL);
+     cheat_assert_pointer(fs_find_name(root, NULL), NULL);
+)
+#endif
+
+#ifdef FS_DEDUP_CONTENTS
+CHEAT_TEST(test_fs_dedup_contents,
+     // Equal contents are stored once, and rewriting one file leaves the
+     // others as they were
+     const char *shared = "{\"status\": \"ok\", \"code\": 200}";
+     content_stats_t before = content_get_stats();
+     node_t *files[3];
+     for (int i = 0; i < 3; i++) {
+         char name[8];
+         sprintf(name, "f%d", i);
+         fs_create(root, name, File);
+         files[i] = fs_find_in_dir(root, name);
+         cheat_assert(fs_set_file_content(files[i], (char *) shared));
+     }
+     cheat_assert_pointer(fs_get_file_content(files[0]), fs_get_file_content(files[2]));
+     content_stats_t stats = content_get_stats();
+     cheat_assert_size(stats.contents, before.contents + 1);
+     cheat_assert_size(stats.references, before.references + 3);
+     cheat_assert_size(stats.copied_bytes - before.copied_bytes, 3 * ((strlen(shared) + 16) & ~(size_t) 15));
+     cheat_assert(fs_set_file_content(files[0], "{\"status\": \"failed\"}"));
+     cheat_assert_string(fs_get_file_content(files[1]), shared);
+     cheat_assert_string(fs_get_file_content(files[0]), "{\"status\": \"failed\"}");
+     cheat_assert_size(content_get_stats().contents, before.contents + 2);
+     // Writing a file its own content again keeps the record
+     char *content = fs_get_file_content(files[1]);
+     cheat_assert(fs_set_file_content(files[1], (char *) shared));
+     cheat_assert_pointer(fs_get_file_content(files[1]), content);
+     // Short contents stay in their node
+     cheat_assert(fs_set_file_content(files[0], "ok"));
+     cheat_assert_size(content_get_stats().contents, before.contents + 1);
+     for (int i = 0; i < 3; i++)
+         fs_delete(files[i], false);
+     stats = content_get_stats();
+     cheat_assert_size(stats.contents, before.contents);
+     cheat_assert_size(stats.references, before.references);
+     cheat_assert_size(stats.bytes, before.bytes);
+)
+#endif
+
+#ifdef FS_COMPRESS_CONTENTS
+CHEAT_TEST(test_fs_compressed_contents,
+     // Large contents are stored compressed and read back through the
+     // cache, which forgets rewritten and deleted files
+     char *content = malloc_or_die(FS_COMPRESS_MIN * 4 + 1);
+     node_t *files[FS_DECODE_CACHE + 1];
+     fs_compress_stats_t before = fs_get_compress_stats();
+     for (int i = 0; i <= FS_DECODE_CACHE; i++) {
+         char name[8];
+         sprintf(name, "f%d", i);
+         fs_create(root, name, File);
+         files[i] = fs_find_in_dir(root, name);
+         for (int j = 0; j < FS_COMPRESS_MIN * 4; j++)
+             content[j] = (char) ('a' + (j / 7 + i) % 26);
+         content[FS_COMPRESS_MIN * 4] = '\0';
+         cheat_assert(fs_set_file_content(files[i], content));
+         cheat_assert_uint8(files[i]->inline_len, FS_CONTENT_COMPRESSED);
+         cheat_assert(files[i]->payload.buffer.capacity < FS_COMPRESS_MIN);
+         cheat_assert_size(fs_get_file_size(files[i]), FS_COMPRESS_MIN * 4);
+     }
+     // Read twice in a row: decoded once
+     for (int i = 0; i <= FS_DECODE_CACHE; i++) {
+         cheat_assert_char(fs_get_file_content(files[i])[1], (char) ('a' + i % 26));
+         cheat_assert_size(strlen(fs_get_file_content(files[i])), FS_COMPRESS_MIN * 4);
+     }
+     fs_compress_stats_t stats = fs_get_compress_stats();
+     cheat_assert_size(stats.files - before.files, FS_DECODE_CACHE + 1);
+     cheat_assert_size(stats.reads - before.reads, 2 * (FS_DECODE_CACHE + 1));
+     cheat_assert_size(stats.decodes - before.decodes, FS_DECODE_CACHE + 1);
+     cheat_assert(stats.compressed_bytes < stats.bytes);
+     // A rewrite is read as written, not as cached
+     content[1] = 'Z';
+     cheat_assert(fs_set_file_content(files[FS_DECODE_CACHE], content));
+     cheat_assert_char(fs_get_file_content(files[FS_DECODE_CACHE])[1], 'Z');
+     cheat_assert(fs_set_file_content(files[FS_DECODE_CACHE], "short"));
+     cheat_assert_string(fs_get_file_content(files[FS_DECODE_CACHE]), "short");
+     // Contents that do not compress are stored as they are
+     uint32_t state = 2463534242u;
+     for (int j = 0; j < FS_COMPRESS_MIN * 4; j++) {
+         state ^= state << 13;
+         state ^= state >> 17;
+         state ^= state << 5;
+         content[j] = (char) ('!' + state % 90);
+     }
+     cheat_assert(fs_set_file_content(files[0], content));
+     cheat_assert(files[0]->inline_len != FS_CONTENT_COMPRESSED);
+     cheat_assert_string(fs_get_file_content(files[0]), content);
+     for (int i = 0; i <= FS_DECODE_CACHE; i++)
+         fs_delete(files[i], false);
+     cheat_assert_size(fs_get_compress_stats().files, before.files);
+     cheat_assert_size(fs_get_compress_stats().bytes, before.bytes);
+     free(content);
+)
+#endif
+
+#if defined(FS_SPILL_CONTENTS) && !defined(FS_DEDUP_CONTENTS)
+CHEAT_TEST(test_fs_spilled_contents,
+     // Over the budget contents go to the spill file, and come back on read.
+     // Four of them fit.
+     enum { FILES = 16, LEN = 2000, BUDGET = 4 * ((LEN + 16) & ~15) };
+     char *content = malloc_or_die(LEN + 1);
+     node_t *files[FILES];
+     fs_set_spill_budget(BUDGET);
+     for (int i = 0; i < FILES; i++) {
+         char name[8];
+         sprintf(name, "f%d", i);
+         fs_create(root, name, File);
+         files[i] = fs_find_in_dir(root, name);
+         memset(content, 'a' + i, LEN);
+         content[LEN] = '\0';
+         cheat_assert(fs_set_file_content(files[i], content));
+     }
+     fs_spill_stats_t stats = fs_get_spill_stats();
+     cheat_assert(stats.resident_bytes <= BUDGET);
+     cheat_assert_size(stats.resident_files + stats.spilled_files, FILES);
+     cheat_assert_size(stats.spilled_bytes, stats.spilled_files * LEN);
+     cheat_assert_size(stats.evicted_bytes, stats.evictions * LEN);
+     cheat_assert(stats.file_bytes >= stats.spilled_bytes);
+     for (int i = 0; i < FILES; i++) {
+         cheat_assert_size(fs_get_file_size(files[i]), LEN);
+         char *read = fs_get_file_content(files[i]);
+         cheat_assert_size(strlen(read), LEN);
+         cheat_assert_char(read[LEN - 1], (char) ('a' + i));
+     }
+     fs_spill_stats_t after = fs_get_spill_stats();
+     cheat_assert_size(after.hits + after.misses - stats.hits - stats.misses, FILES);
+     cheat_assert(after.misses > stats.misses);
+     cheat_assert(after.resident_bytes <= BUDGET);
+     // Read back then evicted again, a content is not written twice
+     fs_set_spill_budget(0);
+     cheat_assert_uint8(files[0]->inline_len, FS_CONTENT_SPILLED);
+     fs_get_file_content(files[0]);
+     cheat_assert_uint8(files[0]->inline_len, FS_CONTENT_BUFFER);
+     stats = fs_get_spill_stats();
+     fs_set_spill_budget(0);
+     cheat_assert_uint8(files[0]->inline_len, FS_CONTENT_SPILLED);
+     cheat_assert_size(fs_get_spill_stats().file_bytes, stats.file_bytes);
+     // Unless it was rewritten in place
+     fs_get_file_content(files[0]);
+     memset(content, 'z', LEN);
+     cheat_assert(fs_set_file_content(files[0], content));
+     fs_set_spill_budget(0);
+     cheat_assert_uint8(files[0]->inline_len, FS_CONTENT_SPILLED);
+     cheat_assert_string(fs_get_file_content(files[0]), content);
+     // The file is emptied with its last content
+     fs_set_spill_budget(FS_SPILL_BUDGET);
+     for (int i = 0; i < FILES; i++)
+         fs_delete(files[i], false);
+     stats = fs_get_spill_stats();
+     cheat_assert_size(stats.resident_files + stats.spilled_files, 0);
+     cheat_assert_size(stats.resident_bytes + stats.spilled_bytes, 0);
+     cheat_assert_size(stats.file_bytes, 0);
+     free(content);
+)
+#endif